@@ -1,9 +1,25 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <memory>
 #include <set>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#include <charconv>
+#include <cmath>
 
 namespace cson {
 
@@ -14,6 +30,12 @@ class Number;
 class String;
 class Boolean;
 class Null;
+class Arena;
+class StringPool;
+class Sink;
+class JSON;
+struct LazyDocument;
+struct LazySource;
 
 class Exception {
 public:
@@ -75,6 +97,185 @@ public:
     IOError(const char* txt, ...) __attribute__((format(printf, 2, 3)));
 };
 
+// Bump allocator owning the entities and character data of a parsed document.
+// Memory is handed out from large blocks and released all at once when the
+// arena is destroyed; single allocations are never freed. Documents share
+// their arena with subtrees taken out of them.
+class Arena : public std::enable_shared_from_this<Arena> {
+public:
+    Arena();
+    ~Arena();
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    const char* copyString(const char* str, size_t length);
+
+    // deletes the object when the arena is destroyed, thread safe
+    template<class T>
+    T* own(T* object) {
+        ownPointer(object, [](void* p) { delete static_cast<T*>(p); });
+        return object;
+    }
+
+    // heap entities added to containers of this arena, deleted with the arena unless released first
+    void adopt(Entity* entity);
+    void release(Entity* entity);
+
+    // keeps another arena alive as long as this one, e.g. for entities moved in from another document
+    void retain(std::shared_ptr<Arena> arena);
+
+    // true if this arena keeps the other one alive, directly or through retained arenas
+    bool retains(const Arena* arena);
+
+    size_t bytesAllocated() const { return mBytesAllocated; }
+
+    // distinct strings of the document, created on first use. findStringPool() does not create it.
+    StringPool& stringPool();
+    const StringPool* findStringPool() const { return mStringPool.get(); }
+
+    // set for lazily parsed documents, whose string pool grows when containers are first accessed
+    void setLazyDocument(const LazyDocument* document) { mLazyDocument = document; }
+    const LazyDocument* lazyDocument() const { return mLazyDocument; }
+
+private:
+    Arena(const Arena&) = delete;
+    void operator=(const Arena&) = delete;
+
+    void* allocateBlock(size_t size, size_t alignment);
+    void ownPointer(void* object, void (*deleter)(void*));
+
+    struct OwnedPointer {
+        void* mObject;
+        void (*mDeleter)(void*);
+    };
+
+    char* mCurrent = nullptr;
+    char* mEnd = nullptr;
+    size_t mNextBlockSize;
+    size_t mBytesAllocated = 0;
+    std::vector<char*> mBlocks;
+
+    std::mutex mOwnedMutex;
+    std::vector<OwnedPointer> mOwnedPointers;
+    std::unordered_set<Entity*> mAdoptedEntities;
+    std::vector<std::shared_ptr<Arena>> mRetainedArenas;
+
+    std::unique_ptr<StringPool> mStringPool;
+    const LazyDocument* mLazyDocument = nullptr;
+};
+
+inline void* Arena::allocate(size_t size, size_t alignment) {
+    const uintptr_t current = reinterpret_cast<uintptr_t>(mCurrent);
+    const uintptr_t aligned = (current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (!mCurrent || aligned + size > reinterpret_cast<uintptr_t>(mEnd)) {
+        return allocateBlock(size, alignment);
+    }
+    mCurrent = reinterpret_cast<char*>(aligned + size);
+    return reinterpret_cast<void*>(aligned);
+}
+
+// Set of the distinct strings in an arena. Repeated keys and short values share
+// one copy, so equal pooled strings also have equal data pointers.
+class StringPool {
+public:
+    explicit StringPool(Arena& arena);
+
+    // returns the pooled string equal to str. On first use str is copied into the
+    // arena, or referenced if it already lives as long as the arena.
+    std::string_view intern(std::string_view str, bool reference = false);
+
+    // the pooled string equal to str, data() is nullptr if there is none
+    std::string_view find(std::string_view str) const;
+
+    size_t size() const { return mCount; }
+
+private:
+    struct Slot {
+        const char* mData = nullptr; // nullptr marks an empty slot
+        size_t mLength = 0;
+        uint32_t mHash = 0;
+    };
+
+    void grow();
+
+    Arena& mArena;
+    std::vector<Slot> mSlots;
+    size_t mCount = 0;
+};
+
+// STL allocator on top of an Arena. Falls back to the heap if no arena is set,
+// so containers of heap and arena entities share one type.
+template<class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena* arena = nullptr) noexcept : mArena(arena) {
+    }
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : mArena(other.arena()) {
+    }
+
+    T* allocate(size_t n) {
+        if (!mArena) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (!mArena) {
+            std::allocator<T>().deallocate(p, n);
+        }
+    }
+
+    Arena* arena() const { return mArena; }
+
+    template<class U>
+    friend bool operator== (const ArenaAllocator& a, const ArenaAllocator<U>& b) { return a.arena() == b.arena(); }
+    template<class U>
+    friend bool operator!= (const ArenaAllocator& a, const ArenaAllocator<U>& b) { return a.arena() != b.arena(); }
+
+private:
+    Arena* mArena;
+};
+
+// Character data of strings, numbers, comments and object keys. Points either
+// into the arena of the owning document or into a std::string owned by the entity.
+// Copies are shallow, the owning entity manages the storage.
+class StringData {
+public:
+    StringData() = default;
+    StringData(const StringData& other);
+    StringData& operator=(const StringData& other);
+
+    std::string_view view() const { return std::string_view(mData, mLength); }
+
+    size_t length() const { return mLength; }
+
+    // for arena data the std::string is created on first use and owned by the arena
+    const std::string& str(Arena* arena) const;
+
+    // publishes a derived string once without changing the data, returns the published one
+    const std::string& cache(Arena* arena, std::string&& str) const;
+
+    void assign(Arena* arena, const char* data, size_t length);
+
+    // points at data owned by the document itself, nothing is copied
+    void reference(const char* data, size_t length);
+
+    // takes over the characters of str, in an arena the moved string is owned by the arena
+    void assign(Arena* arena, std::string&& str);
+
+    // frees the storage of entities that do not live in an arena
+    void release(Arena* arena);
+
+private:
+    const char* mData = "";
+    size_t mLength = 0;
+    mutable std::atomic<const std::string*> mString{nullptr};
+};
 
 class Entity {
 public:
@@ -89,11 +290,19 @@ public:
         comment
     };
 
-    Entity();
+    explicit Entity(Arena* arena = nullptr);
     virtual ~Entity();
 
+    // deletes heap entities, entities in an arena are released with their arena
+    struct Deleter {
+        void operator()(Entity* entity) const;
+    };
+
     virtual Type type() const = 0;
 
+    // arena owning this entity, nullptr for heap allocated entities
+    Arena* arena() const { return mArena; }
+
     const Object& object() const;
     Object& object();
 
@@ -112,7 +321,7 @@ public:
     const Null& null() const;
     Null& null();
 
-    virtual bool contains(const std::string& key) const { (void)key; return false; }
+    virtual bool contains(std::string_view key) const { (void)key; return false; }
 
     virtual const std::string& keyByIndex(size_t index) const;
 
@@ -130,71 +339,110 @@ public:
     double doubleValue() const;
     int intValue() const;
     bool boolValue() const;
+    std::string_view stringView() const;
 
     const Entity& operator[] (size_t idx) const;
-    const Entity& operator[] (const std::string& key) const;
+    const Entity& operator[] (std::string_view key) const;
 
     Entity& operator[] (size_t idx);
-    Entity& operator[] (const std::string& key);
+    Entity& operator[] (std::string_view key);
 
     virtual std::string toString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const = 0;
     virtual Entity* clone() const = 0;
 protected:
+    template<class T>
+    static T* create(Arena* arena) {
+        if (!arena) {
+            return new T();
+        }
+        return new (arena->allocate(sizeof(T), alignof(T))) T(arena);
+    }
+
+    static void destroy(Entity* entity);
+
+    // Children of heap containers are heap entities. Children of arena containers live in
+    // the arena of the container or an arena it retains, or are heap entities owned by it.
+    // adoptChild() takes a subtree without copying it unless this is not possible.
+    Entity* adoptChild(JSON&& value);
+    Entity* adoptChild(std::unique_ptr<Entity> entity);
+    // a child removed from this container
+    void destroyChild(Entity* child);
+    JSON detachChild(Entity* child);
+
     static std::string s_EmptyString;
 
+    Arena* mArena = nullptr;
+
     Entity(const Entity&) = delete;
     void operator=(const Entity&) = delete;
+
+    friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
 };
 
 class Object : public Entity {
 public:
-    Object();
+    struct KeyAndEntity;
+
+private:
+    using Entities = std::vector<KeyAndEntity, ArenaAllocator<KeyAndEntity>>;
+    struct Index;
+
+public:
+    explicit Object(Arena* arena = nullptr);
     ~Object() override;
 
     Type type() const override { return Type::object; }
 
-    bool contains(const std::string& key) const override;
-    bool remove(const std::string& name);
-
-    Array& addArray(const std::string& name);
-    Object& addObject(const std::string& name);
-    Number& addNumber(const std::string& name);
-    Number& addInt(const std::string& name, int i);
-    Number& addFloat(const std::string& name, float f);
-    Number& addDouble(const std::string& name, double d);
-    String& addString(const std::string& name, const char* value = NULL);
-    Boolean& addBoolean(const std::string& name, bool b = false);
-    Null& addNull(const std::string& name);
-
-    Number& setInt(const std::string& name, int i);
-    Number& setFloat(const std::string&name, float f);
-    Number& setDouble(const std::string& name, double d);
-    String& setString(const std::string& name, const char* value = NULL);
-    Boolean& setBoolean(const std::string& name, bool value = false);
-
-    const std::string& stringValueForKey(const char* name, const std::string& defaultValue = s_EmptyString) const { return stringValueForKey(std::string(name), defaultValue); }
-    const std::string& stringValueForKey(const std::string& name, const std::string& defaultValue = s_EmptyString) const;
-    int intValueForKey(const char* name, int defaultValue = 0) const { return intValueForKey(std::string(name), defaultValue); }
-    int intValueForKey(const std::string& name, int defaultValue = 0) const;
-    float floatValueForKey(const char* name, float defaultValue = 0.0f) const { return floatValueForKey(std::string(name), defaultValue); }
-    float floatValueForKey(const std::string& name, float defaultValue = 0.0f) const;
-    double doubleValueForKey(const char* name, double defaultValue = 0.0f) const { return doubleValueForKey(std::string(name), defaultValue); }
-    double doubleValueForKey(const std::string& name, double defaultValue = 0.0f) const;
-    Number* numberForKey(const char* name) const { return numberForKey(std::string(name)); }
-    Number* numberForKey(const std::string& name) const;
-    Array* arrayForKey(const char* name) const { return arrayForKey(std::string(name)); }
-    Array* arrayForKey(const std::string& name) const;
-    Object* objectForKey(const char* name) const { return objectForKey(std::string(name)); }
-    Object* objectForKey(const std::string& name) const;
-    Boolean* boolForKey(const char* name) const { return boolForKey(std::string(name)); }
-    Boolean* boolForKey(const std::string& name) const;
-    bool boolValueForKey(const std::string& name, bool defaultValue = false) const;
-    Null* nullForKey(const std::string& name) const;
-    Entity* entityForKey(const std::string& name) const;
+    bool contains(std::string_view key) const override;
+    bool remove(std::string_view name);
+
+    Array& addArray(std::string_view name);
+    Object& addObject(std::string_view name);
+    Number& addNumber(std::string_view name);
+    Number& addInt(std::string_view name, int i);
+    Number& addFloat(std::string_view name, float f);
+    Number& addDouble(std::string_view name, double d);
+    String& addString(std::string_view name, const char* value = NULL);
+    Boolean& addBoolean(std::string_view name, bool b = false);
+    Null& addNull(std::string_view name);
+
+    // the string is moved, not copied
+    String& addString(std::string_view name, std::string&& value);
+
+    // adds the root of another document. Subtrees of other arenas are linked without
+    // copying and their arena is kept alive, heap objects copy them.
+    Entity& add(std::string_view name, JSON&& value);
+
+    // adds a heap entity, e.g. created with new or clone()
+    Entity& add(std::string_view name, std::unique_ptr<Entity> entity);
+
+    // removes the member and returns it as a document, throws NoSuchKey
+    JSON take(std::string_view name);
+
+    Number& setInt(std::string_view name, int i);
+    Number& setFloat(std::string_view name, float f);
+    Number& setDouble(std::string_view name, double d);
+    String& setString(std::string_view name, const char* value = NULL);
+    Boolean& setBoolean(std::string_view name, bool value = false);
+
+    const std::string& stringValueForKey(std::string_view name, const std::string& defaultValue = s_EmptyString) const;
+    std::string_view stringViewForKey(std::string_view name, std::string_view defaultValue = std::string_view()) const;
+    int intValueForKey(std::string_view name, int defaultValue = 0) const;
+    float floatValueForKey(std::string_view name, float defaultValue = 0.0f) const;
+    double doubleValueForKey(std::string_view name, double defaultValue = 0.0f) const;
+    Number* numberForKey(std::string_view name) const;
+    Array* arrayForKey(std::string_view name) const;
+    Object* objectForKey(std::string_view name) const;
+    Boolean* boolForKey(std::string_view name) const;
+    bool boolValueForKey(std::string_view name, bool defaultValue = false) const;
+    Null* nullForKey(std::string_view name) const;
+    Entity* entityForKey(std::string_view name) const;
 
     const std::string& keyByIndex(size_t index) const override;
 
-    size_t count() const override { return mEntities.size(); }
+    size_t count() const override { materialize(); return mEntities.size(); }
     Entity& entityAtIndex(size_t idx);
     const Entity& entityAtIndex(size_t idx) const;
 
@@ -207,29 +455,31 @@ public:
     struct KeyAndEntity {
         KeyAndEntity() = default;
 
-        KeyAndEntity(const std::string& key_, Entity* entity_) : mKey(key_), mEntity(entity_) {
+        KeyAndEntity(const StringData& key_, Entity* entity_) : mKey(key_), mEntity(entity_) {
         }
 
         Entity* operator->() { return mEntity; }
 
         const Entity* operator->() const { return mEntity; }
 
-        bool operator == (const std::string& key) const { return mKey == key; }
+        bool operator == (std::string_view key) const { return mKey.view() == key; }
 
-        const std::string& key() const { return mKey; }
+        const std::string& key() const { return mKey.str(mEntity->arena()); }
+
+        std::string_view keyView() const { return mKey.view(); }
 
         Entity& entity() { return *mEntity; }
 
         const Entity& entity() const { return *mEntity; }
 
-        std::string mKey;
-        Entity* mEntity;
+        StringData mKey;
+        Entity* mEntity = nullptr;
     };
 
     class Iterator {
     public:
 
-        Iterator(std::vector<KeyAndEntity>::iterator it) : mIterator(it) {
+        Iterator(Entities::iterator it) : mIterator(it) {
         }
 
         using iterator_category = std::forward_iterator_tag;
@@ -253,7 +503,7 @@ public:
         friend bool operator== (const Iterator& a, const Iterator& b) { return a.mIterator == b.mIterator; };
         friend bool operator!= (const Iterator& a, const Iterator& b) { return a.mIterator != b.mIterator; };
     private:
-        std::vector<KeyAndEntity>::iterator mIterator;
+        Entities::iterator mIterator;
     };
 
     class ConstIterator {
@@ -264,7 +514,7 @@ public:
        using pointer           = const value_type*;
        using reference         = const value_type&;
 
-       ConstIterator(const std::vector<KeyAndEntity>::const_iterator it) : mIterator(it) {
+       ConstIterator(const Entities::const_iterator it) : mIterator(it) {
        }
 
        reference operator*() const { return *mIterator; }
@@ -282,27 +532,66 @@ public:
        friend bool operator== (const ConstIterator& a, const ConstIterator& b) { return a.mIterator == b.mIterator; };
        friend bool operator!= (const ConstIterator& a, const ConstIterator& b) { return a.mIterator != b.mIterator; };
     private:
-       std::vector<KeyAndEntity>::const_iterator mIterator;
+       Entities::const_iterator mIterator;
     };
 
-    Iterator begin() { return Iterator(mEntities.begin()); }
-    Iterator end()   { return Iterator(mEntities.end()); }
+    Iterator begin() { materialize(); return Iterator(mEntities.begin()); }
+    Iterator end()   { materialize(); return Iterator(mEntities.end()); }
 
-    ConstIterator begin() const { return ConstIterator(mEntities.begin()); }
-    ConstIterator end() const { return ConstIterator(mEntities.end()); }
+    ConstIterator begin() const { materialize(); return ConstIterator(mEntities.begin()); }
+    ConstIterator end() const { materialize(); return ConstIterator(mEntities.end()); }
 
-    ConstIterator cbegin() { return ConstIterator(mEntities.begin()); }
-    ConstIterator cend()   { return ConstIterator(mEntities.end()); }
+    ConstIterator cbegin() { materialize(); return ConstIterator(mEntities.begin()); }
+    ConstIterator cend()   { materialize(); return ConstIterator(mEntities.end()); }
 
 private:
-    std::vector<KeyAndEntity> mEntities;
-    std::map<std::string, Entity*> mEntityByKey;
+    // parses the members of a lazily parsed object on first access
+    void materialize() const {
+        if (mLazy.load(std::memory_order_acquire)) {
+            expand();
+        }
+    }
+    void expand() const;
+
+    Entity* addEntity(std::string_view name, Entity* entity);
+
+    // removes the member from mEntities and the index, returns its entity
+    Entity* unlink(size_t position);
+
+    // takes the members collected by a parser, comments have an empty key
+    void setMembers(const KeyAndEntity* begin, const KeyAndEntity* end);
+
+    // the last member with the given key, comments are skipped
+    Entity* find(std::string_view key) const;
+    // with the hash of the key computed beforehand, see JSONPointer
+    Entity* find(std::string_view key, uint32_t hash) const;
+    size_t findIndex(std::string_view key) const;
+    size_t scan(std::string_view key) const;
+
+    // the hash index of large objects, built on first use
+    Index* index() const;
+
+    // objects up to this size are searched linearly, larger ones get a hash index on first lookup
+    static constexpr size_t s_LinearScanLimit = 16;
+
+    Entities mEntities;
+    // built lazily by const lookups, kept up to date by modifications once it exists
+    mutable std::atomic<Index*> mIndex{nullptr};
+    // text of the members until they are parsed, see JSON::lazy()
+    mutable std::atomic<const LazySource*> mLazy{nullptr};
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
+    friend class Serializer;
+    friend class JSONPointer;
 };
 
 class Array : public Entity {
+private:
+    using Values = std::vector<Entity*, ArenaAllocator<Entity*>>;
+
 public:
-    Array();
+    explicit Array(Arena* arena = nullptr);
     ~Array() override;
 
     Type type() const override { return Type::array; }
@@ -316,10 +605,19 @@ public:
     Number& addDouble(double value);
     String& addString(const char* str);
     String& addString(const std::string& str);
+    String& addString(std::string&& str);
     Boolean& addBool(bool value);
     Null& addNull();
 
+    // see Object::add()
+    Entity& add(JSON&& value);
+    Entity& add(std::unique_ptr<Entity> entity);
+
+    // removes the element and returns it as a document, throws OutOfBounds
+    JSON takeAtIndex(size_t index);
+
     const std::string& stringValueAtIndex(size_t index, const std::string& defaultValue = s_EmptyString) const;
+    std::string_view stringViewAtIndex(size_t index, std::string_view defaultValue = std::string_view()) const;
     int intValueAtIndex(size_t index, int defaultValue = 0) const;
     float floatValueAtIndex(size_t index, float defaultValue = 0.0f) const;
     double doubleValueAtIndex(size_t index, double defaultValue = 0.0f) const;
@@ -336,12 +634,12 @@ public:
     std::string toString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const override;
     Entity* clone() const override;
 
-    size_t count() const override{ return mValues.size(); }
+    size_t count() const override { materialize(); return mValues.size(); }
 
     class Iterator {
     public:
 
-        Iterator(std::vector<Entity*>::iterator it) : mIterator(it) {
+        Iterator(Values::iterator it) : mIterator(it) {
         }
 
         using iterator_category = std::forward_iterator_tag;
@@ -365,13 +663,13 @@ public:
         friend bool operator== (const Iterator& a, const Iterator& b) { return a.mIterator == b.mIterator; };
         friend bool operator!= (const Iterator& a, const Iterator& b) { return a.mIterator != b.mIterator; };
     private:
-        std::vector<Entity*>::iterator mIterator;
+        Values::iterator mIterator;
     };
 
     class ConstIterator {
     public:
 
-        ConstIterator(const std::vector<Entity*>::const_iterator it) : mIterator(it) {
+        ConstIterator(const Values::const_iterator it) : mIterator(it) {
         }
 
         using iterator_category = std::forward_iterator_tag;
@@ -395,45 +693,65 @@ public:
         friend bool operator== (const ConstIterator& a, const ConstIterator& b) { return a.mIterator == b.mIterator; };
         friend bool operator!= (const ConstIterator& a, const ConstIterator& b) { return a.mIterator != b.mIterator; };
     private:
-        std::vector<Entity*>::const_iterator mIterator;
+        Values::const_iterator mIterator;
     };
 
-    Iterator begin() { return Iterator(mValues.begin()); }
-    Iterator end() { return Iterator(mValues.end()); }
+    Iterator begin() { materialize(); return Iterator(mValues.begin()); }
+    Iterator end() { materialize(); return Iterator(mValues.end()); }
 
-    ConstIterator begin() const { return ConstIterator(mValues.cbegin()); }
-    ConstIterator end() const { return ConstIterator(mValues.cend()); }
+    ConstIterator begin() const { materialize(); return ConstIterator(mValues.cbegin()); }
+    ConstIterator end() const { materialize(); return ConstIterator(mValues.cend()); }
 
-    ConstIterator cbegin() const { return ConstIterator(mValues.cbegin()); }
-    ConstIterator cend() const { return ConstIterator(mValues.cend()); }
+    ConstIterator cbegin() const { materialize(); return ConstIterator(mValues.cbegin()); }
+    ConstIterator cend() const { materialize(); return ConstIterator(mValues.cend()); }
 private:
-    std::vector<Entity*> mValues;
+    // parses the values of a lazily parsed array on first access
+    void materialize() const {
+        if (mLazy.load(std::memory_order_acquire)) {
+            expand();
+        }
+    }
+    void expand() const;
+
+    Values mValues;
+    mutable std::atomic<const LazySource*> mLazy{nullptr};
 
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
+    friend class Serializer;
 };
 
 class String : public Entity {
 public:
-    String();
+    explicit String(Arena* arena = nullptr);
     ~String() override;
 
     Type type() const override { return Type::string; }
 
     void setString(const char* str);
     void setString(const std::string& str);
+    void setString(std::string&& str);
 
     std::string toString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const override;
     Entity* clone() const override;
 
-    const std::string& value() const { return mValue; }
+    const std::string& value() const { return mValue.str(mArena); }
+
+    // does not allocate, in zero copy documents the view may point into the parsed input
+    std::string_view view() const { return mValue.view(); }
 
 private:
-    std::string mValue;
+    StringData mValue;
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
 };
 
 class Number : public Entity {
 public:
+    explicit Number(Arena* arena = nullptr);
+    ~Number() override;
 
     Type type() const override { return Type::number; }
 
@@ -445,19 +763,48 @@ public:
     std::string toString(bool prettyPrint = true, const std::string& indentation = std::string("  "), int level = 0) const override;
     Entity* clone() const override;
 
-    const std::string& value() const { return mNumber; }
+    // the parsed text in documents parsed with Option::preserveNumbers, formatted otherwise
+    const std::string& value() const;
+
+    bool isInteger() const { return mIsInteger; }
+
+    int64_t valueInt64() const { return mIsInteger ? mInt : doubleToInt64(mDouble); }
     int valueInt() const;
-    float valueFloat() const;
-    double valueDouble() const;
+    float valueFloat() const { return static_cast<float>(valueDouble()); }
+    double valueDouble() const { return mIsInteger ? static_cast<double>(mInt) : mDouble; }
+
+    // shortest text that reads back as d, or as the float d if single is set, returns the length
+    static constexpr size_t s_MaxFormattedLength = 32;
+    static size_t formatDouble(char* buf, double d, bool single = false);
 private:
-    std::string mNumber;
+    static int64_t doubleToInt64(double d);
+
+    // sets the value from validated number text, the text itself is not kept
+    void setParsed(std::string_view text);
+
+    // shortest text that reads back as the same value, returns the length
+    size_t format(char* buf) const;
+
+    bool mIsInteger = true;
+    // set by setFloat(), formatted as the shortest text of the float
+    bool mIsSingle = false;
+    union {
+        int64_t mInt = 0;
+        double mDouble;
+    };
+
+    // original text, only kept for round trip exact documents or numbers set with setString()
+    StringData mNumber;
 
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
+    friend class Serializer;
 };
 
 class Boolean : public Entity {
 public:
-    Boolean();
+    explicit Boolean(Arena* arena = nullptr);
     ~Boolean() override;
 
     Type type() const override { return Type::boolean; }
@@ -473,10 +820,12 @@ private:
     bool mValue = false;
 
     friend class Parser;
+    friend class DocumentBuilder;
 };
 
 class Null : public Entity {
 public:
+    explicit Null(Arena* arena = nullptr);
 
     Type type() const override { return Type::null; }
 
@@ -486,10 +835,14 @@ public:
 
 private:
     friend class Parser;
+    friend class DocumentBuilder;
 };
 
 class Comment : public Entity {
 public:
+    explicit Comment(Arena* arena = nullptr);
+    ~Comment() override;
+
     Type type() const override { return Type::comment; }
 
     std::string toString(bool prettyPrint = true, const std::string& identation = {"  "}, int level = 0) const override;
@@ -497,9 +850,11 @@ public:
     Entity* clone() const override;
 private:
 
-    std::string mText;
+    StringData mText;
 
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class Serializer;
 };
 
 class JSON {
@@ -510,6 +865,11 @@ public:
         indent2Spaces,
         indent4Spaces,
         indentTab,
+        // strings without escapes reference the input instead of being copied.
+        // The input has to outlive the document unless it is moved into fromString().
+        zeroCopy,
+        // numbers keep their text and are written exactly as parsed
+        preserveNumbers,
     };
 
     JSON(JSON&& ctx) = default;
@@ -532,22 +892,92 @@ public:
 
     static JSON fromString(const std::string& json, const std::set<Option>& options = {});
 
+    // with Option::zeroCopy the document takes ownership of the input
+    static JSON fromString(std::string&& json, const std::set<Option>& options = {});
+
+    // validates the input, but parses objects and arrays only when they are first
+    // accessed. The input has to outlive the document unless it is moved in.
+    static JSON lazy(const std::string& json, const std::set<Option>& options = {});
+    static JSON lazy(std::string&& json, const std::set<Option>& options = {});
+
     void save(const Entity& entity, const std::string& path, const std::set<Option>& options = {}) const;
 
     std::string toString(const Entity& entity, const std::set<Option>& options = {}) const;
 
+    // the pooled copy of a key of this document, lookups with it compare pointers instead of bytes
+    std::string_view pooledKey(std::string_view key) const;
+
 private:
     JSON() = default;
 
-    JSON(std::unique_ptr<Entity> root);
+    JSON(std::shared_ptr<Arena> arena, Entity* root);
 
     JSON(const JSON&) = delete;
 
     void operator=(const JSON&) = delete;
 
-    std::unique_ptr<Entity> mRoot;
+    // declared before mRoot, the arena has to outlive the entities it owns.
+    // Subtrees taken out of a document share its arena.
+    std::shared_ptr<Arena> mArena;
+
+    std::unique_ptr<Entity, Entity::Deleter> mRoot;
 
+    friend class Entity;
     friend class Parser;
+    friend class DocumentBuilder;
+    friend class BinaryDecoder;
+    friend class Reader;
+};
+
+// Precompiled JSON Pointer (RFC 6901), e.g. "/items/3/name". The reference
+// tokens are unescaped and the keys hashed once, so evaluating the same
+// pointer against many documents only walks the trees.
+class JSONPointer {
+public:
+    // throws ParseError if the pointer is neither empty nor starts with '/', or has an invalid escape
+    explicit JSONPointer(std::string_view pointer);
+
+    // the referenced value, nullptr if a key or index does not exist or a value
+    // on the way is no container. The empty pointer references the root.
+    const Entity* find(const Entity& root) const;
+    Entity* find(Entity& root) const;
+
+    const std::string& str() const { return mPointer; }
+
+    // number of reference tokens
+    size_t size() const { return mTokens.size(); }
+
+private:
+    struct Token {
+        std::string mKey;
+        uint32_t mHash;
+        // the token as array index, npos if it is none
+        size_t mIndex;
+    };
+
+    std::string mPointer;
+    std::vector<Token> mTokens;
+};
+
+// Receives the events of Parser::parse(txt, length, handler) without building
+// entities. Returning false from a callback stops parsing. Strings, keys and
+// numbers are only valid during the callback, numbers are passed as text.
+class Handler {
+public:
+    virtual ~Handler() = default;
+
+    virtual bool startObject() { return true; }
+    virtual bool key(std::string_view key) { (void)key; return true; }
+    virtual bool endObject() { return true; }
+
+    virtual bool startArray() { return true; }
+    virtual bool endArray() { return true; }
+
+    virtual bool string(std::string_view value) { (void)value; return true; }
+    virtual bool number(std::string_view number) { (void)number; return true; }
+    virtual bool boolean(bool value) { (void)value; return true; }
+    virtual bool null() { return true; }
+    virtual bool comment(std::string_view text) { (void)text; return true; }
 };
 
 class Parser final {
@@ -560,10 +990,48 @@ public:
 
     void setMaxDepth(size_t maxDepth);
 
+    // strings without escapes, numbers and comments reference the input instead of copying it
+    void setZeroCopy(bool zeroCopy);
+
+    // keep the text of numbers in addition to their binary value, for round trip exact output
+    void setPreserveNumbers(bool preserve);
+
+    // keys and short string values share one copy per document, enabled by default
+    void setInternStrings(bool intern);
+
+    // validate everything, but parse the members of objects and arrays only on first access.
+    // Strings reference the input, which has to outlive the document like in zero copy mode.
+    void setLazy(bool lazy);
+
+    // parses the elements of a large top-level array on this many threads, 0 uses all cores.
+    // The elements are separated by a sequential scan and spliced into one Array.
+    void setThreads(size_t threads);
+
+    // smaller inputs are always parsed on the calling thread
+    static constexpr size_t s_MinParallelLength = 1 << 20;
+
+    // keeps only the members on the given key paths, e.g. "user.name". The other members
+    // are skipped without building or validating them. Arrays keep their elements, objects
+    // in them are projected like their array. No paths keep everything, lazy parsing ignores them.
+    void setProjection(const std::vector<std::string>& paths);
+
+    // longer string values are not interned, they rarely repeat
+    static constexpr size_t s_MaxInternedValueLength = 32;
+
     JSON parse(const char* txt);
     JSON parse(const char* txt, size_t length);
     JSON parse(const std::string& txt);
 
+    // in zero copy mode the input is moved into the document and lives as long as it
+    JSON parse(std::string&& txt);
+
+    // the file is memory mapped, in zero copy mode the mapping lives as long as the document
+    JSON load(const std::string& path);
+
+    // event based parsing, returns false if the handler stopped parsing
+    bool parse(const char* txt, size_t length, Handler& handler);
+    bool parse(const std::string& txt, Handler& handler);
+
     // static convenience functions
     static JSON parseString(const char* txt, bool allowComments = false);
     static JSON parseString(const char* txt, size_t length, bool allowComments = false);
@@ -572,18 +1040,56 @@ public:
     static JSON parseFile(const std::string& path, bool allowComments = false);
 
 private:
+    JSON parseDocument(std::unique_ptr<Arena> arena);
+
+    // parses the members of a lazy object or array
+    static void expand(Entity& container, const LazySource& source);
+
+    // skips the rest of a validated object or array, the opening bracket has been consumed
+    void skipContainer();
+
+    // skips one value without validating it
+    void skipValue();
+
+    // the opening bracket of the root array has been consumed
+    Array* parseArrayParallel();
+
+    // members kept by a projection, a complete node keeps the whole value
+    struct ProjectionNode {
+        std::vector<std::pair<std::string, size_t>> mChildren; // key and index of its node
+        bool mComplete = false;
+    };
+
+    // the node of a projected key, nullptr if the member is skipped
+    const ProjectionNode* projectedMember(const ProjectionNode& node, std::string_view key) const;
+
+    // the key of a member without copying it, only valid until the next call
+    std::string_view scanKey();
+
+    template<class T>
+    T* parseLazy(size_t depth);
+
     void skipWhitespaces();
     char curChar(bool increment = true);
     bool tryToConsume(const char* txt);
     void consumeOrDie(const char* txt);
-    void readDigits(std::string& dest);
-    std::string parseStringLiteral();
+    void readDigits();
+    std::string_view parseStringLiteral(size_t maxInternedLength = 0);
+    // the key of a member, which unlike parseStringLiteral() requires its opening quote
+    std::string_view parseKey(size_t maxInternedLength = 0);
+    std::string_view scanNumber();
+    std::string_view scanComment();
+
+    bool parseValueEvents(Handler& handler, size_t depth);
+    bool parseArrayEvents(Handler& handler, size_t depth);
+    bool parseObjectEvents(Handler& handler, size_t depth);
 
     Entity* parseValue(size_t depth);
 
-    Array* parseArray(size_t depth);
+    // fills arr if set, creates a new array otherwise
+    Array* parseArray(size_t depth, Array* arr = nullptr);
 
-    Object* parseObject(size_t depth);
+    Object* parseObject(size_t depth, Object* obj = nullptr);
 
     Number* parseNumber();
 
@@ -591,12 +1097,591 @@ private:
 
     Comment* parseComment();
 
+    // stage 2 of DOM parsing, moves between the tokens recorded by stage 1
+    void indexTokens();
+    void nextToken();
+    void endScalar();
+    Entity* parseIndexedValue(size_t depth);
+    Array* parseIndexedArray(size_t depth);
+    Object* parseIndexedObject(size_t depth);
+
     size_t mPosition = 0;
     size_t mLength = 0;
     const char* mText = nullptr;
     bool mAllowComments = false;
+    bool mZeroCopy = false;
+    bool mPreserveNumbers = false;
+    bool mInternStrings = true;
+    bool mLazy = false;
+    size_t mThreads = 1;
+    const LazyDocument* mLazyDocument = nullptr;
+    // number of the next container of the lazy document
+    size_t mLazyContainer = 0;
+
+    // the root node first, empty without a projection
+    std::vector<ProjectionNode> mProjection;
+    // node of the objects currently being parsed, nullptr keeps everything
+    const ProjectionNode* mProjectionNode = nullptr;
+
+    // arena of the document currently being parsed
+    Arena* mArena = nullptr;
+
+    // children of the containers currently being parsed, copied into the
+    // container at its end so the arena holds exactly sized arrays
+    std::vector<Entity*> mValueStack;
+    std::vector<Object::KeyAndEntity> mMemberStack;
+
+    // decoded escaped strings while parsing events
+    std::string mStringBuffer;
+
+    // positions of the tokens in the window of the document being parsed, followed by
+    // its length once the end is indexed
+    std::vector<uint32_t> mTokens;
+    size_t mTokenCount = 0;
+    size_t mNextToken = 0;
+    // end of the indexed part of the document
+    size_t mIndexedLength = 0;
+    // escapes, strings and numbers continuing into the next block of 64 bytes
+    uint64_t mPrevEscaped = 0;
+    uint64_t mPrevInString = 0;
+    uint64_t mPrevScalar = 0;
+    // the window is kept small enough for the tokens to stay in cache
+    static constexpr size_t s_TokenWindowBlocks = 64;
+    // bytes inside strings in the first window, documents with more per token
+    // are parsed from the text
+    size_t mStringBytes = 0;
+    static constexpr size_t s_MaxStringBytesPerToken = 8;
 
     size_t mMaxDepth = 64;
+
+    friend class Object;
+    friend class Array;
+    friend class Reader;
+    friend class LazyIndexer;
+};
+
+// Handler building a document from events, e.g. of a PushParser
+class DocumentBuilder : public Handler {
+public:
+    DocumentBuilder();
+    ~DocumentBuilder() override;
+
+    bool startObject() override;
+    bool key(std::string_view key) override;
+    bool endObject() override;
+
+    bool startArray() override;
+    bool endArray() override;
+
+    bool string(std::string_view value) override;
+    bool number(std::string_view number) override;
+    bool boolean(bool value) override;
+    bool null() override;
+    bool comment(std::string_view text) override;
+
+    // true if the root value is complete
+    bool isComplete() const { return mRoot && mContainers.empty(); }
+
+    // hands out the built document, the builder can be reused afterwards
+    JSON document();
+
+private:
+    DocumentBuilder(const DocumentBuilder&) = delete;
+    void operator=(const DocumentBuilder&) = delete;
+
+    void addValue(Entity* entity);
+    void reset();
+
+    struct Container {
+        Entity* mEntity;
+        size_t mStackStart;
+    };
+
+    std::unique_ptr<Arena> mArena;
+    Entity* mRoot = nullptr;
+    std::vector<Container> mContainers;
+    std::vector<Entity*> mValueStack;
+    std::vector<Object::KeyAndEntity> mMemberStack;
+    StringData mKey;
+};
+
+// Resumable parser for input arriving in chunks, e.g. from sockets or pipes.
+// Tokens may be split at any byte, including inside strings, escapes and numbers.
+// Events are reported to the handler as soon as they are complete.
+class PushParser final {
+public:
+    explicit PushParser(Handler& handler);
+
+    void allowComments(bool allow);
+
+    void setMaxDepth(size_t maxDepth);
+
+    // returns false if the handler stopped parsing, further input is ignored then
+    bool feed(const char* data, size_t length);
+    bool feed(std::string_view data) { return feed(data.data(), data.length()); }
+
+    // true once the root container is closed
+    bool isComplete() const { return mState == State::done; }
+
+    // throws a ParseError if the input ended before the root container was closed
+    void finish();
+
+private:
+    enum class State {
+        start,              // before the root container
+        value,              // after ':' or ',' in an array
+        arrayValueOrEnd,    // after '['
+        objectKeyOrEnd,     // after '{'
+        objectKey,          // after ',' in an object
+        colon,              // after a key
+        commaOrEnd,         // after a value inside a container
+        done,               // root container closed, only whitespace may follow
+        stopped             // the handler returned false
+    };
+
+    enum class Token {
+        none,
+        string,
+        number,
+        literal,
+        comment
+    };
+
+    const char* handleChar(const char* pos);
+    const char* continueString(const char* pos, const char* end);
+    const char* continueNumber(const char* pos, const char* end);
+    const char* continueLiteral(const char* pos, const char* end);
+    const char* continueComment(const char* pos, const char* end);
+
+    void openContainer(char c);
+    void closeContainer(char c);
+    void valueDone(bool ok);
+    void startComment();
+    size_t offset(const char* pos) const { return mOffset + (pos - mChunk); }
+
+    Handler& mHandler;
+    bool mAllowComments = false;
+    size_t mMaxDepth = 64;
+
+    State mState = State::start;
+    std::vector<char> mContainers; // '{' or '[' for every open container
+
+    Token mToken = Token::none;
+    std::string mTokenText;         // the part of the current token seen in previous chunks
+    bool mStringIsKey = false;
+    int mEscape = 0;                // 1 after a backslash, 2 in a \u escape
+    int mUnicodeDigits = 0;
+    int mUnicodeValue = 0;
+    const char* mLiteral = nullptr; // "true", "false" or "null"
+    size_t mLiteralIndex = 0;
+    bool mCommentStarted = false;   // the second '/' of a comment was seen
+
+    const char* mChunk = nullptr;
+    size_t mOffset = 0;             // offset of mChunk in the whole input
+};
+
+// Reads newline delimited JSON (JSON Lines), one document per line. Batches of
+// lines are parsed on worker threads, the callbacks run on the calling thread.
+// Lines with only whitespace are ignored.
+class NDJSONReader final {
+public:
+    // line numbers start at 1, returning false stops reading
+    using Callback = std::function<bool(size_t line, JSON& json)>;
+    using ErrorCallback = std::function<bool(size_t line, const ParseError& error)>;
+
+    NDJSONReader();
+
+    void allowComments(bool allow);
+
+    void setMaxDepth(size_t maxDepth);
+
+    // number of worker threads, 0 uses all cores
+    void setThreads(size_t threads);
+
+    // documents are delivered in input order unless disabled, then as soon as their batch is parsed
+    void setOrdered(bool ordered);
+
+    // bad lines are passed to onError and skipped instead of throwing their ParseError
+    void setSkipBadLines(bool skip, ErrorCallback onError = nullptr);
+
+    // returns the number of documents passed to callback
+    size_t read(const char* data, size_t length, const Callback& callback);
+    size_t read(const std::string& data, const Callback& callback);
+
+    // the file is memory mapped
+    size_t load(const std::string& path, const Callback& callback);
+
+    // bytes per batch, the last line of a batch is completed
+    static constexpr size_t s_BatchLength = 256 * 1024;
+
+private:
+    bool mAllowComments = false;
+    size_t mMaxDepth = 64;
+    size_t mThreads = 0;
+    bool mOrdered = true;
+    bool mSkipBadLines = false;
+    ErrorCallback mOnError;
+};
+
+// Runs read -> parse -> transform -> serialize -> write over JSON Lines. Batches
+// of lines are parsed, transformed and serialized on a work stealing pool while
+// the calling thread cuts the input into batches and writes finished batches in
+// input order. The number of batches in flight is bounded.
+class NDJSONPipeline final {
+public:
+    // runs on the worker threads, returning false drops the record
+    using Transform = std::function<bool(JSON& json)>;
+
+    NDJSONPipeline();
+
+    void allowComments(bool allow);
+
+    void setMaxDepth(size_t maxDepth);
+
+    // number of worker threads, 0 uses all cores
+    void setThreads(size_t threads);
+
+    // batches parsed or waiting to be written, 0 allows 4 per thread
+    void setQueueLength(size_t batches);
+
+    // bad lines are passed to onError and skipped instead of throwing their ParseError
+    void setSkipBadLines(bool skip, NDJSONReader::ErrorCallback onError = nullptr);
+
+    // returns the number of records written, one compact document per line
+    size_t run(const char* data, size_t length, Sink& sink, const Transform& transform);
+    size_t run(const std::string& data, Sink& sink, const Transform& transform);
+
+    // the input file is memory mapped
+    size_t load(const std::string& path, Sink& sink, const Transform& transform);
+
+private:
+    bool mAllowComments = false;
+    size_t mMaxDepth = 64;
+    size_t mThreads = 0;
+    size_t mQueueLength = 0;
+    bool mSkipBadLines = false;
+    NDJSONReader::ErrorCallback mOnError;
+};
+
+class TapeObject;
+class TapeArray;
+
+// Read only view of a value in a Tape. Views are plain pointers into the tape
+// and stay valid as long as the tape exists, also if the tape is moved.
+class TapeValue {
+public:
+    Entity::Type type() const;
+
+    bool isObject() const { return tag() == '{'; }
+    bool isArray() const { return tag() == '['; }
+    bool isString() const { return tag() == '"'; }
+    bool isNumber() const { return tag() == 'l' || tag() == 'd'; }
+    bool isBoolean() const { return tag() == 't' || tag() == 'f'; }
+    bool isNull() const { return tag() == 'n'; }
+
+    // throw InvalidType for other types
+    TapeObject object() const;
+    TapeArray array() const;
+
+    size_t count() const;
+    std::string_view stringView() const;
+    std::string stringValue() const { return std::string(stringView()); }
+    bool isInteger() const { return tag() == 'l'; }
+    int64_t int64Value() const;
+    int intValue() const;
+    double doubleValue() const;
+    float floatValue() const { return static_cast<float>(doubleValue()); }
+    bool boolValue() const;
+
+    // the value at idx of an array, throws OutOfBounds
+    TapeValue operator[] (size_t idx) const;
+    // the value for key of an object, throws NoSuchKey
+    TapeValue operator[] (std::string_view key) const;
+
+private:
+    TapeValue(const uint64_t* words, const char* strings, size_t index) : mWords(words), mStrings(strings), mIndex(index) {
+    }
+
+    char tag() const { return static_cast<char>(mWords[mIndex] >> 56); }
+
+    // index of the word after this value
+    size_t next() const;
+
+    const uint64_t* mWords = nullptr;
+    const char* mStrings = nullptr;
+    size_t mIndex = 0;
+
+    friend class Tape;
+    friend class TapeObject;
+    friend class TapeArray;
+    friend class TapeBuilder;
+};
+
+class TapeObject {
+public:
+    struct Member {
+        std::string_view key() const { return mKey; }
+        const TapeValue& value() const { return mValue; }
+
+        std::string_view mKey;
+        TapeValue mValue;
+    };
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = Member;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        reference operator*() const { return mMember; }
+        pointer operator->() const { return &mMember; }
+
+        Iterator& operator++();
+        Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const Iterator& a, const Iterator& b) { return a.mKeyIndex == b.mKeyIndex; }
+        friend bool operator!= (const Iterator& a, const Iterator& b) { return a.mKeyIndex != b.mKeyIndex; }
+    private:
+        Iterator(const TapeValue& object, size_t keyIndex);
+
+        Member mMember;
+        size_t mKeyIndex;
+        size_t mEnd;
+
+        friend class TapeObject;
+    };
+
+    size_t count() const { return mObject.count(); }
+    bool contains(std::string_view key) const;
+
+    // the last member with the given key, like Object
+    std::optional<TapeValue> valueForKey(std::string_view key) const;
+
+    // throws NoSuchKey
+    TapeValue operator[] (std::string_view key) const;
+
+    std::string_view stringViewForKey(std::string_view name, std::string_view defaultValue = std::string_view()) const;
+    std::string stringValueForKey(std::string_view name, const std::string& defaultValue = std::string()) const;
+    int intValueForKey(std::string_view name, int defaultValue = 0) const;
+    int64_t int64ValueForKey(std::string_view name, int64_t defaultValue = 0) const;
+    float floatValueForKey(std::string_view name, float defaultValue = 0.0f) const;
+    double doubleValueForKey(std::string_view name, double defaultValue = 0.0) const;
+    bool boolValueForKey(std::string_view name, bool defaultValue = false) const;
+    std::optional<TapeObject> objectForKey(std::string_view name) const;
+    std::optional<TapeArray> arrayForKey(std::string_view name) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    explicit TapeObject(const TapeValue& object) : mObject(object) {
+    }
+
+    TapeValue mObject;
+
+    friend class TapeValue;
+};
+
+class TapeArray {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = TapeValue;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        reference operator*() const { return mValue; }
+        pointer operator->() const { return &mValue; }
+
+        Iterator& operator++() {
+            mValue.mIndex = mValue.next();
+            return *this;
+        }
+        Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+
+        friend bool operator== (const Iterator& a, const Iterator& b) { return a.index() == b.index(); }
+        friend bool operator!= (const Iterator& a, const Iterator& b) { return a.index() != b.index(); }
+    private:
+        explicit Iterator(const TapeValue& value) : mValue(value) {
+        }
+
+        size_t index() const { return mValue.mIndex; }
+
+        TapeValue mValue;
+
+        friend class TapeArray;
+    };
+
+    size_t count() const { return mArray.count(); }
+
+    // walks the array up to idx, iterate to visit all values
+    TapeValue operator[] (size_t idx) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    explicit TapeArray(const TapeValue& array) : mArray(array) {
+    }
+
+    TapeValue mArray;
+
+    friend class TapeValue;
+};
+
+// Read only document stored as one tape of tagged 64 bit words and one buffer
+// for strings, without an entity per value. Building, walking and freeing it
+// is much cheaper than an entity tree. Comments are dropped.
+//
+// Each word has its type in the top byte: containers ('{', '[') store the index
+// of their closing word and their count, closing words the index of their
+// opening word, strings ('"') the offset of their length and bytes in the string
+// buffer. Integers ('l') and doubles ('d') are followed by a word with the value.
+// The words after the root are hash tables of the keys of large objects.
+//
+// A tape contains offsets instead of pointers. save() writes it as a snapshot
+// that map() uses in place, the mapped pages are shared between processes.
+class Tape {
+public:
+    static Tape parse(const char* txt, size_t length, bool allowComments = false);
+    static Tape parse(const std::string& txt, bool allowComments = false);
+    static Tape load(const std::string& path, bool allowComments = false);
+
+    // maps a snapshot written by save() on a machine with the same byte order, nothing is parsed
+    static Tape map(const std::string& path);
+
+    void save(const std::string& path) const;
+    void write(Sink& sink) const;
+
+    TapeValue root() const { return TapeValue(wordData(), stringData(), 0); }
+
+    size_t words() const { return mMapping ? mMappedWordCount : mWords.size(); }
+
+private:
+    Tape() = default;
+
+    const uint64_t* wordData() const { return mMapping ? mMappedWords : mWords.data(); }
+    const char* stringData() const { return mMapping ? mMappedStrings : mStrings.data(); }
+
+    std::vector<uint64_t> mWords;
+    std::vector<char> mStrings;
+
+    // snapshot of map(), the pointers point into the mapping
+    std::shared_ptr<const void> mMapping;
+    const uint64_t* mMappedWords = nullptr;
+    size_t mMappedWordCount = 0;
+    const char* mMappedStrings = nullptr;
+    size_t mMappedStringLength = 0;
+
+    friend class TapeBuilder;
+};
+
+// Destination of serialized JSON
+class Sink {
+public:
+    virtual ~Sink() = default;
+
+    virtual void write(const char* data, size_t length) = 0;
+};
+
+// appends to a std::string
+class StringSink : public Sink {
+public:
+    explicit StringSink(std::string& str) : mString(str) {
+    }
+
+    void write(const char* data, size_t length) override { mString.append(data, length); }
+
+private:
+    std::string& mString;
+};
+
+// writes to a FILE, the file is not closed
+class FileSink : public Sink {
+public:
+    explicit FileSink(FILE* file) : mFile(file) {
+    }
+
+    void write(const char* data, size_t length) override;
+
+private:
+    FILE* mFile;
+};
+
+// writes to a file descriptor, the descriptor is not closed
+class FdSink : public Sink {
+public:
+    explicit FdSink(int fd) : mFd(fd) {
+    }
+
+    void write(const char* data, size_t length) override;
+
+private:
+    int mFd;
+};
+
+// writes into a fixed buffer, throws OutOfBounds if the buffer is too small
+class BufferSink : public Sink {
+public:
+    BufferSink(char* buffer, size_t capacity) : mBuffer(buffer), mCapacity(capacity) {
+    }
+
+    void write(const char* data, size_t length) override;
+
+    size_t size() const { return mSize; }
+
+private:
+    char* mBuffer;
+    size_t mCapacity;
+    size_t mSize = 0;
+};
+
+// Writes a tree in a single pass into a sink. Output is collected in a small
+// inline buffer, replaced by a large one once the output outgrows it, and handed
+// to the sink in pieces. Output for a std::string is appended without a sink.
+class Serializer {
+public:
+    Serializer(Sink& sink, bool prettyPrint = true, const std::string& indentation = std::string("  "));
+    Serializer(std::string& output, bool prettyPrint = true, const std::string& indentation = std::string("  "));
+
+    // writes the entity and flushes the output to the sink
+    void write(const Entity& entity, int level = 0);
+
+private:
+    Serializer(const Serializer&) = delete;
+    void operator=(const Serializer&) = delete;
+
+    void writeEntity(const Entity& entity, int level);
+    void writeObject(const Object& object, int level);
+    void writeArray(const Array& array, int level);
+    void writeString(std::string_view str);
+    void writeIndentation(int level);
+
+    void append(const char* data, size_t length);
+    void append(std::string_view str) { append(str.data(), str.length()); }
+    void append(char c);
+    void flush();
+    void growBuffer();
+
+    Sink* mSink; // nullptr when writing into mOutput
+    std::string* mOutput;
+    bool mPrettyPrint;
+    std::string mIndentation;
+    std::string mIndentationCache; // mIndentation repeated for the deepest level so far
+
+    static const size_t InlineBufferSize = 256;
+    static const size_t BufferSize = 64 * 1024;
+    char mInlineBuffer[InlineBufferSize];
+    std::unique_ptr<char[]> mLargeBuffer;
+    char* mBuffer = mInlineBuffer;
+    size_t mBufferSize = InlineBufferSize;
+    size_t mBufferUsed = 0;
+
+    friend class EventWriter;
 };
 
 class Writer {
@@ -605,6 +1690,8 @@ public:
 
     void write(const std::string& path, const Entity& ent);
 
+    void write(Sink& sink, const Entity& ent);
+
     static void writeToFile(const std::string& path, const Entity& ent, bool prettyPrint = true, const std::string& indentation = {"  "}, int level = 0);
 private:
     bool mPrettyPrint = false;
@@ -614,5 +1701,437 @@ private:
     int mLevel = 0;
 };
 
+// CBOR (RFC 8949) encoding of entity trees. Comments are not encoded. Decoding
+// accepts definite and indefinite lengths, tags are ignored and byte strings
+// become strings.
+class CBOR {
+public:
+    static void encode(const Entity& entity, Sink& sink);
+    static std::string encode(const Entity& entity);
+
+    // throws ParseError for malformed input and map keys that are not strings
+    static JSON decode(const char* data, size_t length);
+    static JSON decode(const std::string& data);
+};
+
+// MessagePack encoding of entity trees. Comments are not encoded. Decoding
+// turns binary data into strings and rejects extension types.
+class MessagePack {
+public:
+    static void encode(const Entity& entity, Sink& sink);
+    static std::string encode(const Entity& entity);
+
+    // throws ParseError for malformed input and map keys that are not strings
+    static JSON decode(const char* data, size_t length);
+    static JSON decode(const std::string& data);
+};
+
+// Pull parser reading a text value by value without building entities, used
+// by the struct bindings. Strings and keys are only valid until the next call.
+// Comments are not allowed. Mismatching input throws ParseError.
+class Reader final {
+public:
+    Reader(const char* txt, size_t length);
+    explicit Reader(const std::string& txt);
+
+    void setMaxDepth(size_t maxDepth);
+
+    // type of the next value, it is not consumed
+    Entity::Type peek();
+
+    // startObject() consumes '{', nextKey() then returns false once it consumed '}'
+    void startObject();
+    bool nextKey(std::string_view& key);
+
+    // startArray() consumes '[', nextElement() then returns false once it consumed ']'
+    void startArray();
+    bool nextElement();
+
+    std::string_view readString();
+    bool readBoolean();
+
+    // fractions are truncated and out of range values clamped like in Number
+    int64_t readInt64();
+    uint64_t readUInt64();
+    double readDouble();
+
+    // consumes a null and returns true if the next value is null
+    bool readNull();
+
+    // validates and skips the next value
+    void skipValue();
+
+    // parses the next value into a document of its own
+    JSON readDocument();
+
+    // throws if anything but whitespace follows the root value
+    void finish();
+
+    [[noreturn]] void fail(const char* message);
+
+private:
+    std::string_view readNumber();
+
+    // position in the text, rewinding to it reads the following value again
+    size_t position() const { return mParser.mPosition; }
+    void rewind(size_t position) { mParser.mPosition = position; }
+
+    size_t maxDepth() const { return mParser.mMaxDepth; }
+
+    Parser mParser;
+
+    // per open container: no member read yet
+    std::vector<bool> mFirst;
+
+    friend class PathEvaluator;
+};
+
+// JSONPath subset evaluated while reading the text, without a tree of the whole
+// document. Only matching values are parsed into documents of their own.
+//
+//     $            root
+//     .key ['key'] member
+//     .* [*]       all members or elements
+//     ..key ..*    recursive descent
+//     [2] [-1]     element, negative indices count from the end
+//     [1:5:2]      slice with positive step
+//     [?(@.a.b)]   filter on existence, or comparison with ==, !=, <, <=, >, >=
+//                  and a number, string, true, false or null, e.g. [?(@.price < 10)]
+//
+// Matches are passed in document order. A match containing further matches is
+// read again for them.
+class JSONPath {
+public:
+    // returning false stops the evaluation
+    using Callback = std::function<bool(JSON& match)>;
+
+    // throws ParseError for invalid or unsupported paths
+    explicit JSONPath(std::string_view path);
+    ~JSONPath();
+
+    JSONPath(JSONPath&&) noexcept;
+    JSONPath& operator=(JSONPath&&) noexcept;
+
+    // returns false if the callback stopped the evaluation, throws ParseError for invalid json
+    bool evaluate(const char* txt, size_t length, const Callback& callback) const;
+    bool evaluate(const std::string& txt, const Callback& callback) const;
+
+    // the file is memory mapped and read sequentially
+    bool load(const std::string& path, const Callback& callback) const;
+
+    // all matches
+    std::vector<JSON> select(const std::string& txt) const;
+
+    const std::string& str() const { return mPath; }
+
+private:
+    struct Segment;
+
+    std::string mPath;
+    std::vector<Segment> mSegments;
+
+    friend class PathCompiler;
+    friend class PathEvaluator;
+};
+
+// Handler writing the events as compact JSON text into a sink, e.g. to
+// serialize bound structs or to reencode the events of a PushParser.
+// The output is flushed once the root value is complete.
+class EventWriter : public Handler {
+public:
+    explicit EventWriter(Sink& sink);
+    explicit EventWriter(std::string& output);
+
+    bool startObject() override;
+    bool key(std::string_view key) override;
+    bool endObject() override;
+
+    bool startArray() override;
+    bool endArray() override;
+
+    bool string(std::string_view value) override;
+    bool number(std::string_view number) override;
+    bool boolean(bool value) override;
+    bool null() override;
+    bool comment(std::string_view text) override;
+
+private:
+    // writes the comma before a value or key unless it is the first in its container
+    void separate();
+    void endValue();
+
+    Serializer mSerializer;
+    std::vector<bool> mFirst;
+    bool mAfterKey = false;
+};
+
+// Member of a struct bound to a key, see CSON_BIND
+template<class T, class M>
+struct Field {
+    std::string_view mName;
+    M T::* mMember;
+};
+
+template<class T, class M>
+constexpr Field<T, M> field(std::string_view name, M T::* member) {
+    return Field<T, M>{name, member};
+}
+
+// Binds the members of a struct to keys of the same name, at namespace scope of the struct:
+//
+//     struct Point { int x; int y; std::optional<std::string> label; };
+//     CSON_BIND(Point, CSON_FIELD(x), CSON_FIELD(y), CSON_FIELD(label))
+//
+// cson::field("key", &CsonBound::member) binds a member to a differently named key.
+#define CSON_FIELD(member) cson::field(#member, &CsonBound::member)
+#define CSON_BIND(Type, ...) \
+    constexpr auto csonFields(const Type*) { using CsonBound = Type; return std::make_tuple(__VA_ARGS__); }
+
+// Reads a value from a Reader and writes it as events to a Handler. Specialized
+// for bool, numbers, std::string, std::vector, std::optional, maps with string
+// keys and bound structs, other types can be added by further specializations.
+template<class T, class Enable = void>
+struct Binding {
+    static_assert(sizeof(T) == 0, "No binding for this type, use CSON_BIND or specialize cson::Binding");
+};
+
+template<class T, class = void>
+struct IsBound : std::false_type {
+};
+
+template<class T>
+struct IsBound<T, std::void_t<decltype(csonFields(static_cast<const T*>(nullptr)))>> : std::true_type {
+};
+
+template<>
+struct Binding<bool> {
+    static void read(Reader& reader, bool& value) { value = reader.readBoolean(); }
+    static void write(Handler& handler, bool value) { handler.boolean(value); }
+};
+
+template<class T>
+struct Binding<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>> {
+    static void read(Reader& reader, T& value) {
+        if constexpr (std::is_unsigned<T>::value) {
+            const uint64_t u = reader.readUInt64();
+            value = u > std::numeric_limits<T>::max() ? std::numeric_limits<T>::max() : static_cast<T>(u);
+            return;
+        }
+        const int64_t i = reader.readInt64();
+        if (i < static_cast<int64_t>(std::numeric_limits<T>::min())) {
+            value = std::numeric_limits<T>::min();
+        } else if (i > 0 && static_cast<uint64_t>(i) > static_cast<uint64_t>(std::numeric_limits<T>::max())) {
+            value = std::numeric_limits<T>::max();
+        } else {
+            value = static_cast<T>(i);
+        }
+    }
+
+    static void write(Handler& handler, T value) {
+        char buf[24];
+        handler.number(std::string_view(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr - buf));
+    }
+};
+
+template<class T>
+struct Binding<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static void read(Reader& reader, T& value) { value = static_cast<T>(reader.readDouble()); }
+
+    static void write(Handler& handler, T value) {
+        if (!std::isfinite(value)) {
+            handler.null(); // not representable in json
+            return;
+        }
+        char buf[Number::s_MaxFormattedLength];
+        handler.number(std::string_view(buf, Number::formatDouble(buf, value, std::is_same<T, float>::value)));
+    }
+};
+
+template<>
+struct Binding<std::string> {
+    static void read(Reader& reader, std::string& value) { value = reader.readString(); }
+    static void write(Handler& handler, const std::string& value) { handler.string(value); }
+};
+
+template<class T>
+struct Binding<std::vector<T>> {
+    static void read(Reader& reader, std::vector<T>& value) {
+        value.clear();
+        reader.startArray();
+        while (reader.nextElement()) {
+            T element{};
+            Binding<T>::read(reader, element);
+            value.push_back(std::move(element));
+        }
+    }
+
+    static void write(Handler& handler, const std::vector<T>& value) {
+        handler.startArray();
+        for (const auto& element : value) {
+            Binding<T>::write(handler, element);
+        }
+        handler.endArray();
+    }
+};
+
+template<class T>
+struct Binding<std::optional<T>> {
+    static void read(Reader& reader, std::optional<T>& value) {
+        if (reader.readNull()) {
+            value.reset();
+            return;
+        }
+        Binding<T>::read(reader, value.emplace());
+    }
+
+    static void write(Handler& handler, const std::optional<T>& value) {
+        if (value) {
+            Binding<T>::write(handler, *value);
+        } else {
+            handler.null();
+        }
+    }
+};
+
+template<class Map>
+struct MapBinding {
+    static void read(Reader& reader, Map& value) {
+        value.clear();
+        reader.startObject();
+        std::string_view key;
+        while (reader.nextKey(key)) {
+            // the key is only valid until the value is read
+            auto& element = value[std::string(key)];
+            Binding<typename Map::mapped_type>::read(reader, element);
+        }
+    }
+
+    static void write(Handler& handler, const Map& value) {
+        handler.startObject();
+        for (const auto& member : value) {
+            handler.key(member.first);
+            Binding<typename Map::mapped_type>::write(handler, member.second);
+        }
+        handler.endObject();
+    }
+};
+
+template<class T>
+struct Binding<std::map<std::string, T>> : MapBinding<std::map<std::string, T>> {
+};
+
+template<class T>
+struct Binding<std::unordered_map<std::string, T>> : MapBinding<std::unordered_map<std::string, T>> {
+};
+
+// Keys are matched against the field names known at compile time. They usually
+// arrive in the declared order, so the field after the previous one is tried
+// first. Unknown keys are skipped, members without a key keep their value.
+template<class T>
+struct Binding<T, std::enable_if_t<IsBound<T>::value>> {
+    static constexpr auto s_Fields = csonFields(static_cast<const T*>(nullptr));
+    static constexpr size_t s_Count = std::tuple_size<decltype(s_Fields)>::value;
+    using Indices = std::make_index_sequence<s_Count>;
+
+    static void read(Reader& reader, T& value) {
+        reader.startObject();
+        std::string_view key;
+        size_t expected = 0;
+        while (reader.nextKey(key)) {
+            size_t index = expected < s_Count && nameOf(expected, Indices()) == key ? expected : indexOf(key, Indices());
+            if (index == s_Count) {
+                reader.skipValue();
+                continue;
+            }
+            readField(reader, value, index, Indices());
+            expected = index + 1;
+        }
+    }
+
+    static void write(Handler& handler, const T& value) {
+        handler.startObject();
+        std::apply([&](const auto&... field) { (writeField(handler, value, field), ...); }, s_Fields);
+        handler.endObject();
+    }
+
+private:
+    template<size_t... I>
+    static std::string_view nameOf(size_t index, std::index_sequence<I...>) {
+        std::string_view name;
+        ((I == index && (name = std::get<I>(s_Fields).mName, true)) || ...);
+        return name;
+    }
+
+    // index of the field named key, s_Count if there is none
+    template<size_t... I>
+    static size_t indexOf(std::string_view key, std::index_sequence<I...>) {
+        size_t index = s_Count;
+        ((std::get<I>(s_Fields).mName == key && (index = I, true)) || ...);
+        return index;
+    }
+
+    template<size_t... I>
+    static void readField(Reader& reader, T& value, size_t index, std::index_sequence<I...>) {
+        ((I == index && (readMember(reader, value, std::get<I>(s_Fields)), true)) || ...);
+    }
+
+    template<class C, class M>
+    static void readMember(Reader& reader, T& value, const Field<C, M>& field) {
+        Binding<M>::read(reader, value.*field.mMember);
+    }
+
+    template<class M>
+    static bool isEmpty(const M&) { return false; }
+
+    template<class M>
+    static bool isEmpty(const std::optional<M>& value) { return !value; }
+
+    // empty optionals are left out
+    template<class C, class M>
+    static void writeField(Handler& handler, const T& value, const Field<C, M>& field) {
+        const M& member = value.*field.mMember;
+        if (isEmpty(member)) {
+            return;
+        }
+        handler.key(field.mName);
+        Binding<M>::write(handler, member);
+    }
+};
+
+// deserializes a bound struct or any other type with a Binding directly from text
+template<class T>
+void fromJSON(const char* txt, size_t length, T& value) {
+    Reader reader(txt, length);
+    Binding<T>::read(reader, value);
+    reader.finish();
+}
+
+template<class T>
+void fromJSON(const std::string& txt, T& value) {
+    fromJSON(txt.data(), txt.length(), value);
+}
+
+template<class T>
+T fromJSON(const std::string& txt) {
+    T value{};
+    fromJSON(txt, value);
+    return value;
+}
+
+// serializes as compact text, Binding<T>::write() with a DocumentBuilder creates a tree instead
+template<class T>
+void toJSON(const T& value, Sink& sink) {
+    EventWriter writer(sink);
+    Binding<T>::write(writer, value);
+}
+
+template<class T>
+std::string toJSON(const T& value) {
+    std::string str;
+    EventWriter writer(str);
+    Binding<T>::write(writer, value);
+    return str;
+}
+
 } // cson
 
@@ -5,6 +5,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <charconv>
+#include <cmath>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else // !_WIN32
+#include <io.h>
+#endif // !_WIN32
 
 #ifndef _WIN32
 #define MJSONvsprintf(str, size, format, args) vsnprintf(str, size, format, args)
@@ -12,6 +29,33 @@
 #define MJSONvsprintf(str, size, format, args) vsprintf_s(str, size, format, args)
 #endif // !_WIN32
 
+// floating point std::from_chars and std::to_chars are missing in libc++ before LLVM 20,
+// strtod_l with the C locale and snprintf are used instead
+#if !defined(__cpp_lib_to_chars)
+#define CSON_NO_FLOAT_CHARCONV 1
+#include <locale.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+#endif
+
+#if defined(__AVX2__)
+#define CSON_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSON_SSE2 1
+#endif
+
+#if defined(CSON_AVX2)
+#include <immintrin.h>
+#elif defined(CSON_SSE2)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace cson {
 
 std::string Entity::s_EmptyString;
@@ -126,64 +170,333 @@ IOError::IOError(const char* txt, ...)
     mMessage = std::string(buf);
 }
 
-static std::string EscapeString(const std::string& str) {
-    int escapeCount = 0;
-    for (std::string::size_type i = 0; i < str.length(); i++) {
-        char c = str[i];
-        if (c == '\b' ||
-            c == '\r' ||
-            c == '\n' ||
-            c == '\f' ||
-            c == '\t' ||
-            c == '\\' ||
-            c == '/' ||
-            c == '\"') {
-            escapeCount++;
-        }
-    }
-    std::string out;
-    out.reserve(str.length() + escapeCount);
-    for (std::string::size_type i = 0; i < str.length(); i++) {
-        char c = str[i];
-        switch (c) {
-        case '\b':
-            out += "\\b";
-            break;
-        case '\r':
-            out += "\\r";
-            break;
-        case '\n':
-            out += "\\n";
-            break;
-        case '\f':
-            out += "\\f";
-            break;
-        case '\t':
-            out += "\\t";
-            break;
-        case '\\':
-            out += "\\\\";
-            break;
-        case '/':
-            out += "\\/";
-            break;
-        case '\"':
-            out += "\\\"";
-            break;
-        default:
-            out += c;
-            break;
+static const std::string& emptyString() {
+    static const std::string empty;
+    return empty;
+}
+
+static uint32_t hashString(std::string_view str) {
+    uint32_t h = 2166136261u;
+    for (const char c : str) {
+        h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return h;
+}
+
+// pooled strings are equal if their pointers are, the bytes are only compared otherwise
+static inline bool keysEqual(std::string_view a, std::string_view b) {
+    return a.length() == b.length() && (a.data() == b.data() || memcmp(a.data(), b.data(), a.length()) == 0);
+}
+
+static const size_t ArenaMinBlockSize = 4096;
+static const size_t ArenaMaxBlockSize = 1024 * 1024;
+
+Arena::Arena()
+: mNextBlockSize(ArenaMinBlockSize)
+{
+}
+
+Arena::~Arena() {
+    for (auto* entity : mAdoptedEntities) {
+        delete entity;
+    }
+    for (auto& owned : mOwnedPointers) {
+        owned.mDeleter(owned.mObject);
+    }
+    for (auto* block : mBlocks) {
+        ::operator delete(block);
+    }
+}
+
+void* Arena::allocateBlock(size_t size, size_t alignment) {
+    const size_t required = size + alignment;
+    if (required > mNextBlockSize / 2) {
+        // large allocations get a block of their own, the current block stays in use
+        auto* block = static_cast<char*>(::operator new(required));
+        mBlocks.push_back(block);
+        mBytesAllocated += required;
+        const uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    auto* block = static_cast<char*>(::operator new(mNextBlockSize));
+    mBlocks.push_back(block);
+    mBytesAllocated += mNextBlockSize;
+    mCurrent = block;
+    mEnd = block + mNextBlockSize;
+    mNextBlockSize = std::min(mNextBlockSize * 2, ArenaMaxBlockSize);
+    return allocate(size, alignment);
+}
+
+const char* Arena::copyString(const char* str, size_t length) {
+    if (length == 0) {
+        return "";
+    }
+    auto* dest = static_cast<char*>(allocate(length, 1));
+    memcpy(dest, str, length);
+    return dest;
+}
+
+void Arena::ownPointer(void* object, void (*deleter)(void*)) {
+    std::lock_guard<std::mutex> lock(mOwnedMutex);
+    mOwnedPointers.push_back(OwnedPointer{object, deleter});
+}
+
+void Arena::adopt(Entity* entity) {
+    std::lock_guard<std::mutex> lock(mOwnedMutex);
+    mAdoptedEntities.insert(entity);
+}
+
+void Arena::release(Entity* entity) {
+    std::lock_guard<std::mutex> lock(mOwnedMutex);
+    mAdoptedEntities.erase(entity);
+}
+
+void Arena::retain(std::shared_ptr<Arena> arena) {
+    std::lock_guard<std::mutex> lock(mOwnedMutex);
+    if (std::find(mRetainedArenas.begin(), mRetainedArenas.end(), arena) == mRetainedArenas.end()) {
+        mRetainedArenas.push_back(std::move(arena));
+    }
+}
+
+bool Arena::retains(const Arena* arena) {
+    std::vector<std::shared_ptr<Arena>> retained;
+    {
+        std::lock_guard<std::mutex> lock(mOwnedMutex);
+        retained = mRetainedArenas;
+    }
+    for (const auto& candidate : retained) {
+        if (candidate.get() == arena || candidate->retains(arena)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+StringPool& Arena::stringPool() {
+    if (!mStringPool) {
+        mStringPool = std::make_unique<StringPool>(*this);
+    }
+    return *mStringPool;
+}
+
+StringPool::StringPool(Arena& arena)
+: mArena(arena),
+  mSlots(64)
+{
+}
+
+std::string_view StringPool::intern(std::string_view str, bool reference) {
+    if ((mCount + 1) * 2 > mSlots.size()) {
+        grow();
+    }
+
+    const uint32_t hash = hashString(str);
+    const size_t mask = mSlots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        auto& slot = mSlots[i];
+        if (!slot.mData) {
+            slot.mData = reference && str.data() ? str.data() : mArena.copyString(str.data(), str.length());
+            slot.mLength = str.length();
+            slot.mHash = hash;
+            mCount++;
+            return std::string_view(slot.mData, slot.mLength);
+        }
+        if (slot.mHash == hash && keysEqual(std::string_view(slot.mData, slot.mLength), str)) {
+            return std::string_view(slot.mData, slot.mLength);
+        }
+    }
+}
+
+std::string_view StringPool::find(std::string_view str) const {
+    const uint32_t hash = hashString(str);
+    const size_t mask = mSlots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const auto& slot = mSlots[i];
+        if (!slot.mData) {
+            return std::string_view();
+        }
+        if (slot.mHash == hash && keysEqual(std::string_view(slot.mData, slot.mLength), str)) {
+            return std::string_view(slot.mData, slot.mLength);
+        }
+    }
+}
+
+void StringPool::grow() {
+    std::vector<Slot> slots(mSlots.size() * 2);
+    const size_t mask = slots.size() - 1;
+    for (const auto& slot : mSlots) {
+        if (!slot.mData) {
+            continue;
+        }
+        size_t i = slot.mHash & mask;
+        while (slots[i].mData) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+    mSlots.swap(slots);
+}
+
+StringData::StringData(const StringData& other)
+: mData(other.mData),
+  mLength(other.mLength),
+  mString(other.mString.load(std::memory_order_acquire))
+{
+}
+
+StringData& StringData::operator=(const StringData& other) {
+    mData = other.mData;
+    mLength = other.mLength;
+    mString.store(other.mString.load(std::memory_order_acquire), std::memory_order_release);
+    return *this;
+}
+
+const std::string& StringData::str(Arena* arena) const {
+    const auto* str = mString.load(std::memory_order_acquire);
+    if (str) {
+        return *str;
+    }
+    if (mLength == 0 || !arena) {
+        return emptyString();
+    }
+
+    // several threads may race here, the first one wins and the others drop their copy
+    auto* created = new std::string(mData, mLength);
+    if (mString.compare_exchange_strong(str, created, std::memory_order_acq_rel)) {
+        return *arena->own(created);
+    }
+    delete created;
+    return *str;
+}
+
+void StringData::assign(Arena* arena, const char* data, size_t length) {
+    if (arena) {
+        mData = arena->copyString(data, length);
+        mLength = length;
+        mString.store(nullptr, std::memory_order_release);
+        return;
+    }
+
+    auto* str = const_cast<std::string*>(mString.load(std::memory_order_acquire));
+    if (str) {
+        str->assign(data, length);
+    } else {
+        str = new std::string(data, length);
+        mString.store(str, std::memory_order_release);
+    }
+    mData = str->data();
+    mLength = str->length();
+}
+
+void StringData::assign(Arena* arena, std::string&& str) {
+    std::string* owned = nullptr;
+    if (arena) {
+        owned = arena->own(new std::string(std::move(str)));
+    } else {
+        owned = const_cast<std::string*>(mString.load(std::memory_order_acquire));
+        if (owned) {
+            *owned = std::move(str);
+        } else {
+            owned = new std::string(std::move(str));
         }
     }
-    return out;
+    mData = owned->data();
+    mLength = owned->length();
+    mString.store(owned, std::memory_order_release);
 }
 
-Entity::Entity() {
+const std::string& StringData::cache(Arena* arena, std::string&& str) const {
+    const std::string* cached = mString.load(std::memory_order_acquire);
+    if (cached) {
+        return *cached;
+    }
+
+    auto* created = new std::string(std::move(str));
+    if (mString.compare_exchange_strong(cached, created, std::memory_order_acq_rel)) {
+        return arena ? *arena->own(created) : *created;
+    }
+    delete created;
+    return *cached;
+}
+
+void StringData::reference(const char* data, size_t length) {
+    mData = data;
+    mLength = length;
+    mString.store(nullptr, std::memory_order_release);
+}
+
+void StringData::release(Arena* arena) {
+    if (!arena) {
+        delete mString.load(std::memory_order_acquire);
+    }
+    mString.store(nullptr, std::memory_order_release);
+    mData = "";
+    mLength = 0;
+}
+
+Entity::Entity(Arena* arena)
+: mArena(arena)
+{
 }
 
 Entity::~Entity() {
 }
 
+void Entity::Deleter::operator()(Entity* entity) const {
+    destroy(entity);
+}
+
+void Entity::destroy(Entity* entity) {
+    // entities in an arena never own heap memory and are released with the arena
+    if (entity && !entity->mArena) {
+        delete entity;
+    }
+}
+
+Entity* Entity::adoptChild(JSON&& value) {
+    Entity* child = value.mRoot.get();
+    Arena* arena = child->mArena;
+    if (!arena) {
+        return adoptChild(std::unique_ptr<Entity>(value.mRoot.release()));
+    }
+
+    // arenas retaining each other would never be released
+    if (!mArena || (arena != mArena && arena->retains(mArena))) {
+        return adoptChild(std::unique_ptr<Entity>(child->clone()));
+    }
+    if (arena != mArena) {
+        mArena->retain(arena->shared_from_this());
+    }
+    value.mRoot.release();
+    return child;
+}
+
+Entity* Entity::adoptChild(std::unique_ptr<Entity> entity) {
+    Entity* child = entity.release();
+    if (mArena) {
+        mArena->adopt(child);
+    }
+    return child;
+}
+
+void Entity::destroyChild(Entity* child) {
+    if (mArena && !child->mArena) {
+        mArena->release(child);
+    }
+    destroy(child);
+}
+
+JSON Entity::detachChild(Entity* child) {
+    if (!child->mArena) {
+        if (mArena) {
+            mArena->release(child);
+        }
+        return JSON(nullptr, child);
+    }
+    return JSON(child->mArena->shared_from_this(), child);
+}
+
 bool Entity::isObject() const {
     return dynamic_cast<const Object*>(this) != NULL;
 }
@@ -323,7 +636,7 @@ const std::string& Entity::stringValue() const {
 }
 
 int Entity::intValue() const {
-    return atoi(number().value().c_str());
+    return number().valueInt();
 }
 
 float Entity::floatValue() const {
@@ -331,13 +644,20 @@ float Entity::floatValue() const {
 }
 
 double Entity::doubleValue() const {
-    return atof(number().value().c_str());
+    return number().valueDouble();
 }
 
 bool Entity::boolValue() const {
     return boolean().value();
 }
 
+std::string_view Entity::stringView() const {
+    if (!isString()) {
+        throw Exception("Called StringView for non string entity");
+    }
+    return string().view();
+}
+
 const Entity& Entity::operator[] (size_t idx) const {
     if (isArray()) {
         return array().entityAtIndex(idx);
@@ -349,7 +669,7 @@ const Entity& Entity::operator[] (size_t idx) const {
     }
 }
 
-const Entity& Entity::operator[] (const std::string& key) const {
+const Entity& Entity::operator[] (std::string_view key) const {
     if (!isObject()) {
         throw Exception("operator[](key) is only allowed for objects");
     }
@@ -367,232 +687,444 @@ Entity& Entity::operator[] (size_t idx) {
     }
 }
 
-Entity& Entity::operator[] (const std::string& key) {
+Entity& Entity::operator[] (std::string_view key) {
     if (!isObject()) {
         throw Exception("operator[](key) is only allowed for objects");
     }
     return *object().entityForKey(key);
 }
 
+JSONPointer::JSONPointer(std::string_view pointer)
+: mPointer(pointer)
+{
+    if (!pointer.empty() && pointer[0] != '/') {
+        throw ParseError(pointer.data(), pointer.length(), 0, "JSON pointer has to start with '/'");
+    }
+
+    size_t position = 1;
+    while (position <= pointer.length()) {
+        size_t end = pointer.find('/', position);
+        if (end == std::string_view::npos) {
+            end = pointer.length();
+        }
+
+        Token token;
+        for (size_t i = position; i < end; i++) {
+            if (pointer[i] != '~') {
+                token.mKey += pointer[i];
+            } else if (i + 1 < end && (pointer[i + 1] == '0' || pointer[i + 1] == '1')) {
+                token.mKey += pointer[++i] == '0' ? '~' : '/';
+            } else {
+                throw ParseError(pointer.data(), pointer.length(), i, "Invalid escape in JSON pointer");
+            }
+        }
+        token.mHash = hashString(token.mKey);
+
+        // array indices are digits without leading zeros, "-" (after the last element) never exists
+        const auto& key = token.mKey;
+        token.mIndex = std::string::npos;
+        if (!key.empty() && key.length() < 20 && (key[0] != '0' || key.length() == 1)
+            && key.find_first_not_of("0123456789") == std::string::npos) {
+            token.mIndex = std::stoull(key);
+        }
+
+        mTokens.push_back(std::move(token));
+        position = end + 1;
+    }
+}
+
+const Entity* JSONPointer::find(const Entity& root) const {
+    const Entity* entity = &root;
+    for (const auto& token : mTokens) {
+        if (entity->type() == Entity::Type::object) {
+            entity = static_cast<const Object*>(entity)->find(token.mKey, token.mHash);
+            if (!entity) {
+                return nullptr;
+            }
+        } else if (entity->type() == Entity::Type::array) {
+            const auto* array = static_cast<const Array*>(entity);
+            if (token.mIndex >= array->count()) {
+                return nullptr;
+            }
+            entity = &array->entityAtIndex(token.mIndex);
+        } else {
+            return nullptr;
+        }
+    }
+    return entity;
+}
+
+Entity* JSONPointer::find(Entity& root) const {
+    return const_cast<Entity*>(find(static_cast<const Entity&>(root)));
+}
+
+Number::Number(Arena* arena)
+: Entity(arena)
+{
+}
+
+Number::~Number() {
+    mNumber.release(mArena);
+}
+
 void Number::setInt(int i) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "%d", i);
-    mNumber = buf;
+    mNumber.release(mArena);
+    mIsInteger = true;
+    mIsSingle = false;
+    mInt = i;
 }
 
 void Number::setFloat(float f) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "%f", f);
-    mNumber = buf;
+    setDouble(f);
+    mIsSingle = true;
 }
 
 void Number::setDouble(double d) {
-    char buf[256];
-    snprintf(buf, sizeof(buf), "%f", d);
-    mNumber = buf;
+    mNumber.release(mArena);
+    mIsInteger = false;
+    mIsSingle = false;
+    mDouble = d;
 }
 
 void Number::setString(const std::string& num) {
-    mNumber = num;
+    setParsed(num);
+    mNumber.assign(mArena, num.data(), num.length());
+}
+
+// like std::from_chars for doubles, independent of the global locale
+static std::from_chars_result parseDouble(const char* begin, const char* end, double& d) {
+#if !defined(CSON_NO_FLOAT_CHARCONV)
+    return std::from_chars(begin, end, d);
+#else
+    // strtod needs terminated text, copy the characters a number can consist of
+    size_t length = 0;
+    while (begin + length < end && ((begin[length] >= '0' && begin[length] <= '9')
+           || begin[length] == '-' || begin[length] == '+' || begin[length] == '.' || begin[length] == 'e' || begin[length] == 'E')) {
+        length++;
+    }
+    char buf[64];
+    std::string longText;
+    const char* text = buf;
+    if (length < sizeof(buf)) {
+        memcpy(buf, begin, length);
+        buf[length] = '\0';
+    } else {
+        longText.assign(begin, length);
+        text = longText.c_str();
+    }
+
+    static const locale_t cLocale = newlocale(LC_ALL_MASK, "C", nullptr);
+    char* stop = nullptr;
+    errno = 0;
+    const double value = strtod_l(text, &stop, cLocale);
+    std::from_chars_result result{begin + (stop - text), std::errc()};
+    if (stop == text) {
+        result.ec = std::errc::invalid_argument;
+    } else if (errno == ERANGE) {
+        result.ec = std::errc::result_out_of_range;
+    } else {
+        d = value;
+    }
+    return result;
+#endif
+}
+
+// converts validated number text, returns true and sets i for integers, sets d otherwise
+static bool parseNumberText(std::string_view text, int64_t& i, double& d) {
+    const char* begin = text.data();
+    const char* end = begin + text.length();
+
+    // negative zero keeps its sign as a double
+    if (text != "-0") {
+        const auto intResult = std::from_chars(begin, end, i);
+        if (intResult.ec == std::errc() && intResult.ptr == end) {
+            return true;
+        }
+    }
+
+    // fractions, exponents and integers exceeding 64 bit
+    d = 0.0;
+    parseDouble(begin, end, d);
+    return false;
+}
+
+static int64_t clampToInt64(double d) {
+    if (std::isnan(d)) {
+        return 0;
+    }
+    if (d <= static_cast<double>(INT64_MIN)) {
+        return INT64_MIN;
+    }
+    if (d >= static_cast<double>(INT64_MAX)) {
+        return INT64_MAX;
+    }
+    return static_cast<int64_t>(d);
+}
+
+static int clampToInt(int64_t i) {
+    if (i < INT_MIN) {
+        return INT_MIN;
+    }
+    if (i > INT_MAX) {
+        return INT_MAX;
+    }
+    return static_cast<int>(i);
+}
+
+void Number::setParsed(std::string_view text) {
+    mIsSingle = false;
+    int64_t i = 0;
+    double d = 0.0;
+    mIsInteger = parseNumberText(text, i, d);
+    if (mIsInteger) {
+        mInt = i;
+    } else {
+        mDouble = d;
+    }
+}
+
+int64_t Number::doubleToInt64(double d) {
+    return clampToInt64(d);
 }
 
 int Number::valueInt() const {
-    std::stringstream stream(mNumber);
-    int v;
-    stream >> v;
-    if (stream.fail()) {
-        v = 0;
+    return clampToInt(valueInt64());
+}
+
+// std::to_chars produces the shortest round trip text (Ryu in libstdc++ and MSVC)
+size_t Number::formatDouble(char* buf, double d, bool single) {
+#if !defined(CSON_NO_FLOAT_CHARCONV)
+    char* end = buf + s_MaxFormattedLength;
+    if (single) {
+        return std::to_chars(buf, end, static_cast<float>(d)).ptr - buf;
+    }
+    return std::to_chars(buf, end, d).ptr - buf;
+#else
+    // the lowest precision that reads back as the same value, %.17g always does
+    const char point = *localeconv()->decimal_point;
+    int length = 0;
+    for (int precision = single ? 6 : 15; precision <= (single ? 9 : 17); precision++) {
+        length = snprintf(buf, s_MaxFormattedLength, "%.*g", precision, d);
+        if (point != '.') {
+            std::replace(buf, buf + length, point, '.');
+        }
+        double parsed = 0.0;
+        parseDouble(buf, buf + length, parsed);
+        if (single ? static_cast<float>(parsed) == static_cast<float>(d) : parsed == d) {
+            break;
+        }
     }
-    return v;
+    // like std::to_chars, integral values are written without exponent if that is not longer
+    if (std::trunc(d) == d && std::fabs(d) < 1e20) {
+        char fixed[s_MaxFormattedLength];
+        const int fixedLength = snprintf(fixed, sizeof(fixed), "%.0f", d);
+        if (fixedLength <= length) {
+            memcpy(buf, fixed, fixedLength);
+            length = fixedLength;
+        }
+    }
+    return length;
+#endif
 }
 
-float Number::valueFloat() const {
-    std::stringstream stream(mNumber);
-    float v;
-    stream >> v;
-    if (stream.fail()) {
-        v = 0.0f;
+size_t Number::format(char* buf) const {
+    if (mIsInteger) {
+        return std::to_chars(buf, buf + s_MaxFormattedLength, mInt).ptr - buf;
     }
-    return v;
+    if (!std::isfinite(mDouble)) {
+        memcpy(buf, "null", 4); // not representable in json
+        return 4;
+    }
+    return formatDouble(buf, mDouble, mIsSingle);
 }
 
-double Number::valueDouble() const {
-    std::stringstream stream(mNumber);
-    double v;
-    stream >> v;
-    if (stream.fail()) {
-        v = 0.0;
+const std::string& Number::value() const {
+    if (mNumber.length() > 0) {
+        return mNumber.str(mArena);
     }
-    return v;
+    char buf[s_MaxFormattedLength];
+    const size_t length = format(buf);
+    return mNumber.cache(mArena, std::string(buf, length));
 }
 
 std::string Number::toString(bool prettyPrint, const std::string& indentation, int level) const {
-    return mNumber;
+    return value();
 }
 
 Entity* Number::clone() const {
     auto* clone = new Number();
-    clone->mNumber = mNumber;
+    clone->mIsInteger = mIsInteger;
+    clone->mIsSingle = mIsSingle;
+    if (mIsInteger) {
+        clone->mInt = mInt;
+    } else {
+        clone->mDouble = mDouble;
+    }
+    const auto number = mNumber.view();
+    if (!number.empty()) {
+        clone->mNumber.assign(nullptr, number.data(), number.length());
+    }
     return clone;
 }
 
-String::String() {
+String::String(Arena* arena)
+: Entity(arena)
+{
 }
 
 String::~String() {
+    mValue.release(mArena);
 }
 
 void String::setString(const char* str) {
-    mValue = std::string(str);
+    mValue.assign(mArena, str, str ? strlen(str) : 0);
 }
 
 void String::setString(const std::string& str) {
-    mValue = str;
+    mValue.assign(mArena, str.data(), str.length());
+}
+
+void String::setString(std::string&& str) {
+    mValue.assign(mArena, std::move(str));
 }
 
 std::string String::toString(bool prettyPrint, const std::string& indentation, int level) const {
     std::string s;
-    s += "\"";
-    s += EscapeString(mValue);
-    s += "\"";
+    Serializer(s, prettyPrint, indentation).write(*this, level);
     return s;
 }
 
 Entity* String::clone() const {
     auto* clone = new String();
-    clone->mValue = mValue;
+    const auto value = mValue.view();
+    clone->mValue.assign(nullptr, value.data(), value.length());
     return clone;
 }
 
-Array::Array() {
+Array::Array(Arena* arena)
+: Entity(arena),
+  mValues(ArenaAllocator<Entity*>(arena))
+{
 }
 
 Array::~Array() {
     for (size_t i = 0; i < mValues.size(); i++) {
-        delete mValues[i];
+        destroy(mValues[i]);
     }
 }
 
 void Array::removeAtIndex(size_t index) {
-    if (index >= mValues.size()) {
+    if (index >= count()) {
+        throw OutOfBounds();
+    }
+    auto* ent = mValues[index];
+    mValues.erase(mValues.begin() + index);
+    destroyChild(ent);
+}
+
+JSON Array::takeAtIndex(size_t index) {
+    if (index >= count()) {
         throw OutOfBounds();
     }
     auto* ent = mValues[index];
-    delete ent;
     mValues.erase(mValues.begin() + index);
+    return detachChild(ent);
+}
+
+Entity& Array::add(JSON&& value) {
+    materialize();
+    auto* ent = adoptChild(std::move(value));
+    mValues.push_back(ent);
+    return *ent;
+}
+
+Entity& Array::add(std::unique_ptr<Entity> entity) {
+    materialize();
+    auto* ent = adoptChild(std::move(entity));
+    mValues.push_back(ent);
+    return *ent;
 }
 
 Array& Array::addArray() {
-    auto* arr = new Array();
+    auto* arr = create<Array>(mArena);
+    materialize();
     mValues.push_back(arr);
     return *arr;
 }
 
 Object& Array::addObject() {
-    auto* arr = new Object();
+    auto* arr = create<Object>(mArena);
+    materialize();
     mValues.push_back(arr);
     return *arr;
 }
 
 Number& Array::addInt(int value) {
-    auto* num = new Number();
+    auto* num = create<Number>(mArena);
     num->setInt(value);
+    materialize();
     mValues.push_back(num);
     return *num;
 }
 
 Number& Array::addFloat(float value) {
-    auto* num = new Number();
+    auto* num = create<Number>(mArena);
     num->setFloat(value);
+    materialize();
     mValues.push_back(num);
     return *num;
 }
 
 Number& Array::addDouble(double value) {
-    auto* num = new Number();
+    auto* num = create<Number>(mArena);
     num->setDouble(value);
+    materialize();
     mValues.push_back(num);
     return *num;
 }
 
 String& Array::addString(const char* str) {
-    auto* s = new String();
+    auto* s = create<String>(mArena);
     s->setString(str);
+    materialize();
     mValues.push_back(s);
     return *s;
 }
 
 String& Array::addString(const std::string& str) {
-    auto* s = new String();
+    auto* s = create<String>(mArena);
     s->setString(str);
+    materialize();
+    mValues.push_back(s);
+    return *s;
+}
+
+String& Array::addString(std::string&& str) {
+    auto* s = create<String>(mArena);
+    s->setString(std::move(str));
+    materialize();
     mValues.push_back(s);
     return *s;
 }
 
 Boolean& Array::addBool(bool value) {
-    auto* b = new Boolean();
+    auto* b = create<Boolean>(mArena);
     b->setBool(value);
+    materialize();
     mValues.push_back(b);
     return *b;
 }
 
 Null& Array::addNull() {
-    auto* n = new Null();
+    auto* n = create<Null>(mArena);
+    materialize();
     mValues.push_back(n);
     return *n;
 }
 
-static void writeCommaIfNeeded(std::string& str, const std::vector<Entity*>& entities, size_t index) {
-    if (entities.at(index)->type() == Entity::Type::comment) {
-        return;
-    }
-
-    bool needsComma = false;
-    for (size_t i = index + 1; i < entities.size(); i++) {
-        if (entities.at(i)->type() != Entity::Type::comment) {
-            needsComma = true;
-            break;
-        }
-    }
-
-    if (needsComma) {
-        str += ",";
-    }
-}
-
 std::string Array::toString(bool prettyPrint, const std::string& indentation, int level) const {
-
-    std::string s = "[";
-    if (prettyPrint) {
-        std::string prefix;
-        for (size_t i = 0; i < level; i++) {
-            prefix += indentation;
-        }
-
-        s += "\n";
-        for (size_t i = 0; i < mValues.size(); i++) {
-            s += prefix;
-            s += indentation;
-
-            auto* entity = mValues.at(i);
-            s += entity->toString(prettyPrint, indentation, level + 1);
-            writeCommaIfNeeded(s, mValues, i);
-
-            s += "\n";
-        }
-        s += prefix;
-    } else {
-        for (size_t i = 0; i < mValues.size(); i++) {
-            auto* entity = mValues.at(i);
-            if (entity->type() == Type::comment) {
-                continue;
-            }
-
-            s += entity->toString(prettyPrint, indentation, level + 1);
-            writeCommaIfNeeded(s, mValues, i);
-        }
-    }
-    s += "]";
+    std::string s;
+    Serializer(s, prettyPrint, indentation).write(*this, level);
     return s;
 }
 
@@ -604,6 +1136,14 @@ const std::string& Array::stringValueAtIndex(size_t index, const std::string& de
     return static_cast<String*>(mValues[index])->value();
 }
 
+std::string_view Array::stringViewAtIndex(size_t index, std::string_view defaultValue) const
+{
+    if (index >= count() || !mValues[index] || !mValues[index]->isString()) {
+        return defaultValue;
+    }
+    return static_cast<String*>(mValues[index])->view();
+}
+
 Number& Array::numberAtIndex(size_t index) const
 {
     if (index >= count() || !mValues[index] || !mValues[index]->isNumber()) {
@@ -694,16 +1234,19 @@ Null& Array::nullAtIndex(size_t index) const
 
 Entity& Array::entityAtIndex(size_t index)
 {
+    materialize();
     return *mValues[index];
 }
 
 const Entity& Array::entityAtIndex(size_t index) const
 {
+    materialize();
     return *mValues[index];
 }
 
 Entity* Array::clone() const
 {
+    materialize();
     auto* clone = new Array();
     clone->mValues.resize(mValues.size());
     for (std::size_t i = 0; i < mValues.size(); i++) {
@@ -713,119 +1256,331 @@ Entity* Array::clone() const
     return clone;
 }
 
-Object::Object()
-{
-}
+// open addressing hash table over the member positions, later duplicates replace earlier ones
+struct Object::Index {
+    struct Slot {
+        uint32_t hash;
+        uint32_t position; // member position + 1, 0 marks an empty slot
+    };
 
-Object::~Object()
-{
-    for (auto& entity : mEntities) {
-        delete entity.mEntity;
+    explicit Index(const Entities& entities) {
+        rebuild(entities);
     }
-}
 
-bool Object::contains(const std::string& key) const
-{
-    return mEntityByKey.find(key) != mEntityByKey.end();
+    void rebuild(const Entities& entities) {
+        size_t capacity = 16;
+        while (capacity < entities.size() * 2) {
+            capacity *= 2;
+        }
+        mSlots.reset(new Slot[capacity]());
+        mMask = capacity - 1;
+        mCount = 0;
+        mDuplicates = false;
+        for (size_t i = 0; i < entities.size(); i++) {
+            insert(entities, i);
+        }
+    }
+
+    void insert(const Entities& entities, size_t position) {
+        const auto& member = entities[position];
+        if (member.mEntity->type() == Entity::Type::comment) {
+            return;
+        }
+        if ((mCount + 1) * 2 > mMask + 1) {
+            rebuild(entities); // includes position
+            return;
+        }
+
+        const auto key = member.mKey.view();
+        const uint32_t h = hashString(key);
+        for (size_t i = h & mMask; ; i = (i + 1) & mMask) {
+            auto& slot = mSlots[i];
+            if (slot.position == 0) {
+                slot.hash = h;
+                slot.position = static_cast<uint32_t>(position + 1);
+                mCount++;
+                return;
+            }
+            if (slot.hash == h && keysEqual(entities[slot.position - 1].mKey.view(), key)) {
+                slot.position = static_cast<uint32_t>(position + 1);
+                mDuplicates = true;
+                return;
+            }
+        }
+    }
+
+    // removes the member at position, which is still in entities, and moves the slots
+    // of the later members down by one. Returns false if the index has to be rebuilt
+    // instead, because an earlier member with the same key takes its place or most
+    // slots are empty.
+    bool erase(const Entities& entities, size_t position) {
+        const auto& member = entities[position];
+        if (member.mEntity->type() != Entity::Type::comment) {
+            if (mDuplicates) {
+                return false;
+            }
+            size_t hole = hashString(member.mKey.view()) & mMask;
+            while (mSlots[hole].position != position + 1) {
+                if (mSlots[hole].position == 0) {
+                    return false;
+                }
+                hole = (hole + 1) & mMask;
+            }
+            // move later slots of the probe sequence into the hole unless that is before their hash
+            mSlots[hole].position = 0;
+            for (size_t i = (hole + 1) & mMask; mSlots[i].position != 0; i = (i + 1) & mMask) {
+                const size_t home = mSlots[i].hash & mMask;
+                if (((i - home) & mMask) >= ((i - hole) & mMask)) {
+                    mSlots[hole] = mSlots[i];
+                    mSlots[i].position = 0;
+                    hole = i;
+                }
+            }
+            mCount--;
+        }
+        // a table emptied by removals is rebuilt smaller
+        if (mMask + 1 > 16 && (mCount + 1) * 8 < mMask + 1) {
+            return false;
+        }
+        if (position + 1 < entities.size()) {
+            const uint32_t removed = static_cast<uint32_t>(position + 1);
+            for (size_t i = 0; i <= mMask; i++) {
+                mSlots[i].position -= mSlots[i].position > removed;
+            }
+        }
+        return true;
+    }
+
+    size_t find(const Entities& entities, std::string_view key, uint32_t h) const {
+        for (size_t i = h & mMask; ; i = (i + 1) & mMask) {
+            const auto& slot = mSlots[i];
+            if (slot.position == 0) {
+                return std::string::npos;
+            }
+            if (slot.hash == h && keysEqual(entities[slot.position - 1].mKey.view(), key)) {
+                return slot.position - 1;
+            }
+        }
+    }
+
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask = 0;
+    size_t mCount = 0;
+    // a key replaced an earlier member, removing it has to find that member again
+    bool mDuplicates = false;
+};
+
+Object::Object(Arena* arena)
+: Entity(arena),
+  mEntities(ArenaAllocator<KeyAndEntity>(arena))
+{
+}
+
+Object::~Object()
+{
+    for (auto& entity : mEntities) {
+        entity.mKey.release(mArena);
+        destroy(entity.mEntity);
+    }
+    if (!mArena) {
+        delete mIndex.load(std::memory_order_acquire);
+    }
+}
+
+Entity* Object::find(std::string_view key) const
+{
+    const size_t position = findIndex(key);
+    return position == std::string::npos ? nullptr : mEntities[position].mEntity;
+}
+
+Entity* Object::find(std::string_view key, uint32_t hash) const
+{
+    materialize();
+    const size_t position = mEntities.size() <= s_LinearScanLimit ? scan(key) : index()->find(mEntities, key, hash);
+    return position == std::string::npos ? nullptr : mEntities[position].mEntity;
+}
+
+size_t Object::findIndex(std::string_view key) const
+{
+    materialize();
+    if (mEntities.size() <= s_LinearScanLimit) {
+        return scan(key);
+    }
+    return index()->find(mEntities, key, hashString(key));
+}
+
+Object::Index* Object::index() const
+{
+    auto* index = mIndex.load(std::memory_order_acquire);
+    if (!index) {
+        // concurrent readers may race to build it, the first one published wins
+        auto* created = new Index(mEntities);
+        if (mIndex.compare_exchange_strong(index, created, std::memory_order_acq_rel)) {
+            index = mArena ? mArena->own(created) : created;
+        } else {
+            delete created;
+        }
+    }
+    return index;
+}
+
+size_t Object::scan(std::string_view key) const
+{
+    for (size_t i = mEntities.size(); i-- > 0; ) {
+        const auto& member = mEntities[i];
+        if (keysEqual(member.mKey.view(), key) && member.mEntity->type() != Type::comment) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+Entity* Object::addEntity(std::string_view name, Entity* entity)
+{
+    materialize();
+    KeyAndEntity keyAndEntity;
+    keyAndEntity.mKey.assign(mArena, name.data(), name.length());
+    keyAndEntity.mEntity = entity;
+    mEntities.push_back(keyAndEntity);
+    if (auto* index = mIndex.load(std::memory_order_acquire)) {
+        index->insert(mEntities, mEntities.size() - 1);
+    }
+    return entity;
+}
+
+bool Object::contains(std::string_view key) const
+{
+    return findIndex(key) != std::string::npos;
 }
 
-Array& Object::addArray(const std::string& name)
+Array& Object::addArray(std::string_view name)
 {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* arr = new Array();
-    mEntities.push_back(KeyAndEntity(name, arr));
-    mEntityByKey[name] = arr;
+    auto* arr = create<Array>(mArena);
+    addEntity(name, arr);
     return *arr;
 }
 
-Object& Object::addObject(const std::string& name)
+Object& Object::addObject(std::string_view name)
 {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* obj = new Object();
-    mEntities.push_back(KeyAndEntity(name, obj));
-    mEntityByKey[name] = obj;
+    auto* obj = create<Object>(mArena);
+    addEntity(name, obj);
     return *obj;
 }
 
-Number& Object::addNumber(const std::string& name) {
+Number& Object::addNumber(std::string_view name) {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* num = new Number();
-    mEntities.push_back(KeyAndEntity(name, num));
-    mEntityByKey[name] = num;
+    auto* num = create<Number>(mArena);
+    addEntity(name, num);
     return *num;
 }
 
-Number& Object::addInt(const std::string& name, int i)
+Number& Object::addInt(std::string_view name, int i)
 {
     auto& number = addNumber(name);
     number.setInt(i);
     return number;
 }
 
-Number& Object::addFloat(const std::string& name, float f)
+Number& Object::addFloat(std::string_view name, float f)
 {
     auto& number = addNumber(name);
     number.setFloat(f);
     return number;
 }
 
-Number& Object::addDouble(const std::string& name, double d)
+Number& Object::addDouble(std::string_view name, double d)
 {
     auto& number = addNumber(name);
     number.setDouble(d);
     return number;
 }
 
-String& Object::addString(const std::string& name, const char* value)
+String& Object::addString(std::string_view name, const char* value)
 {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* str = new String();
+    auto* str = create<String>(mArena);
     if (value) {
         str->setString(value);
     }
-    mEntities.push_back(KeyAndEntity(name, str));
-    mEntityByKey[name] = str;
+    addEntity(name, str);
+    return *str;
+}
+
+String& Object::addString(std::string_view name, std::string&& value)
+{
+    if (contains(name)) {
+        throw NoSuchKey();
+    }
+
+    auto* str = create<String>(mArena);
+    str->setString(std::move(value));
+    addEntity(name, str);
     return *str;
 }
 
-Boolean& Object::addBoolean(const std::string& name, bool b)
+Entity& Object::add(std::string_view name, JSON&& value)
+{
+    if (contains(name)) {
+        throw NoSuchKey();
+    }
+    return *addEntity(name, adoptChild(std::move(value)));
+}
+
+Entity& Object::add(std::string_view name, std::unique_ptr<Entity> entity)
+{
+    if (contains(name)) {
+        throw NoSuchKey();
+    }
+    return *addEntity(name, adoptChild(std::move(entity)));
+}
+
+JSON Object::take(std::string_view name)
+{
+    const size_t position = findIndex(name);
+    if (position == std::string::npos) {
+        throw NoSuchKey();
+    }
+    return detachChild(unlink(position));
+}
+
+Boolean& Object::addBoolean(std::string_view name, bool b)
 {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* boolean = new Boolean();
+    auto* boolean = create<Boolean>(mArena);
     boolean->setBool(b);
-    mEntities.push_back(KeyAndEntity(name, boolean));
-    mEntityByKey[name] = boolean;
+    addEntity(name, boolean);
     return *boolean;
 }
 
-Null& Object::addNull(const std::string& name)
+Null& Object::addNull(std::string_view name)
 {
     if (contains(name)) {
         throw NoSuchKey();
     }
 
-    auto* null = new Null();
-    mEntities.push_back(KeyAndEntity(name, null));
-    mEntityByKey[name] = null;
+    auto* null = create<Null>(mArena);
+    addEntity(name, null);
     return *null;
 }
 
-Number& Object::setInt(const std::string& name, int i)
+Number& Object::setInt(std::string_view name, int i)
 {
     auto* ent = entityForKey(name);
     if (!ent) {
@@ -840,7 +1595,7 @@ Number& Object::setInt(const std::string& name, int i)
     return ent->number();
 }
 
-Number& Object::setFloat(const std::string& name, float f)
+Number& Object::setFloat(std::string_view name, float f)
 {
     auto* ent = entityForKey(name);
     if (!ent) {
@@ -855,7 +1610,7 @@ Number& Object::setFloat(const std::string& name, float f)
     return ent->number();
 }
 
-Number& Object::setDouble(const std::string& name, double d)
+Number& Object::setDouble(std::string_view name, double d)
 {
     auto* ent = entityForKey(name);
     if (!ent) {
@@ -870,7 +1625,7 @@ Number& Object::setDouble(const std::string& name, double d)
     return ent->number();
 }
 
-String& Object::setString(const std::string& name, const char* value)
+String& Object::setString(std::string_view name, const char* value)
 {
     auto* ent = entityForKey(name);
     if (!ent) {
@@ -885,7 +1640,7 @@ String& Object::setString(const std::string& name, const char* value)
     return ent->string();
 }
 
-Boolean& Object::setBoolean(const std::string& name, bool b) {
+Boolean& Object::setBoolean(std::string_view name, bool b) {
     auto* ent = entityForKey(name);
     if (!ent) {
         return addBoolean(name, b);
@@ -900,108 +1655,54 @@ Boolean& Object::setBoolean(const std::string& name, bool b) {
 }
 
 Entity& Object::entityAtIndex(size_t idx) {
+    materialize();
     return *mEntities[idx].mEntity;
 }
 
 const Entity& Object::entityAtIndex(size_t idx) const {
+    materialize();
     return *mEntities[idx].mEntity;
 }
 
 const std::string& Object::keyByIndex(size_t idx) const {
-    return mEntities[idx].mKey;
-}
-
-static void writeCommaIfNeeded(std::string& str, const std::vector<Object::KeyAndEntity>& entities, size_t index) {
-    if (entities.at(index).mEntity->type() == Entity::Type::comment) {
-        return;
-    }
-
-    bool needsComma = false;
-    for (size_t i = index + 1; i < entities.size(); i++) {
-        if (entities.at(i).mEntity->type() != Entity::Type::comment) {
-            needsComma = true;
-            break;
-        }
-    }
-
-    if (needsComma) {
-        str += ",";
-    }
+    materialize();
+    return mEntities[idx].key();
 }
 
 std::string Object::toString(bool prettyPrint, const std::string& indentation, int level) const {
     std::string s;
-    if (prettyPrint) {
-        std::string prefix;
-        for (int i = 0; i < level; i++) {
-            prefix += indentation;
-        }
-
-        if (level > 0) {
-            s += "\n";
-        }
-
-        s += prefix + "{";
-        s += "\n";
-
-        for (size_t i = 0; i < mEntities.size(); i++) {
-            const auto& entityAndKey = mEntities.at(i);
-
-            s += prefix + indentation;
-            if (entityAndKey.mEntity->type() != Entity::Type::comment) {
-                s += "\"";
-                s += EscapeString(entityAndKey.mKey);
-                s += "\"";
-                s += ":";
-            }
-            s += entityAndKey.mEntity->toString(prettyPrint, indentation, level + 1);
-
-            writeCommaIfNeeded(s, mEntities, i);
-            s += "\n";
-
-        }
-        s += "\n";
-        s += prefix;
-    } else {
-        s += "{";
-
-        for (size_t i = 0; i < mEntities.size(); i++) {
-            const auto& entityAndKey = mEntities.at(i);
-            if (entityAndKey.mEntity->type() == Type::comment) {
-                continue;
-            }
+    Serializer(s, prettyPrint, indentation).write(*this, level);
+    return s;
+}
 
-            s += "\"";
-            s += EscapeString(entityAndKey.mKey);
-            s += "\"";
-            s += ":";
-            s += entityAndKey.mEntity->toString(prettyPrint, indentation, level + 1);
-            writeCommaIfNeeded(s, mEntities, i);
-        }
+const std::string& Object::stringValueForKey(std::string_view name, const std::string& defaultValue) const
+{
+    auto* entity = find(name);
+    if (!entity || !entity->isString()) {
+        return defaultValue;
     }
-    s += "}";
-    return s;
+    return static_cast<String*>(entity)->value();
 }
 
-const std::string& Object::stringValueForKey(const std::string& name, const std::string& defaultValue) const
+std::string_view Object::stringViewForKey(std::string_view name, std::string_view defaultValue) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isString()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isString()) {
         return defaultValue;
     }
-    return static_cast<String*>(it->second)->value();
+    return static_cast<String*>(entity)->view();
 }
 
-Number* Object::numberForKey(const std::string& name) const
+Number* Object::numberForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isNumber()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isNumber()) {
         return nullptr;
     }
-    return static_cast<Number*>(it->second);
+    return static_cast<Number*>(entity);
 }
 
-int Object::intValueForKey(const std::string& name, int defaultValue) const
+int Object::intValueForKey(std::string_view name, int defaultValue) const
 {
     auto* number = numberForKey(name);
     if (!number) {
@@ -1010,7 +1711,7 @@ int Object::intValueForKey(const std::string& name, int defaultValue) const
     return number->valueInt();
 }
 
-float Object::floatValueForKey(const std::string& name, float defaultValue) const
+float Object::floatValueForKey(std::string_view name, float defaultValue) const
 {
     auto* number = numberForKey(name);
     if (!number) {
@@ -1019,7 +1720,7 @@ float Object::floatValueForKey(const std::string& name, float defaultValue) cons
     return number->valueFloat();
 }
 
-double Object::doubleValueForKey(const std::string& name, double defaultValue) const
+double Object::doubleValueForKey(std::string_view name, double defaultValue) const
 {
     auto* number = numberForKey(name);
     if (!number) {
@@ -1028,34 +1729,34 @@ double Object::doubleValueForKey(const std::string& name, double defaultValue) c
     return number->valueDouble();
 }
 
-Array* Object::arrayForKey(const std::string& name) const
+Array* Object::arrayForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isArray()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isArray()) {
         return NULL;
     }
-    return static_cast<Array*>(it->second);
+    return static_cast<Array*>(entity);
 }
 
-Object* Object::objectForKey(const std::string& name) const
+Object* Object::objectForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isObject()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isObject()) {
         return nullptr;
     }
-    return static_cast<Object*>(it->second);
+    return static_cast<Object*>(entity);
 }
 
-Boolean* Object::boolForKey(const std::string& name) const
+Boolean* Object::boolForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isBoolean()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isBoolean()) {
         return nullptr;
     }
-    return static_cast<Boolean*>(it->second);
+    return static_cast<Boolean*>(entity);
 }
 
-bool Object::boolValueForKey(const std::string& name, bool defaultValue) const
+bool Object::boolValueForKey(std::string_view name, bool defaultValue) const
 {
     auto* b = boolForKey(name);
     if (!b) {
@@ -1064,50 +1765,66 @@ bool Object::boolValueForKey(const std::string& name, bool defaultValue) const
     return b->value();
 }
 
-Null* Object::nullForKey(const std::string& name) const
+Null* Object::nullForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second || !it->second->isNull()) {
+    auto* entity = find(name);
+    if (!entity || !entity->isNull()) {
         return nullptr;
     }
-    return static_cast<Null*>(it->second);
+    return static_cast<Null*>(entity);
 }
 
-Entity* Object::entityForKey(const std::string& name) const
+Entity* Object::entityForKey(std::string_view name) const
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end() || !it->second) {
+    auto* entity = find(name);
+    if (!entity) {
         return nullptr;
     }
-    return it->second;
+    return entity;
 }
 
-bool Object::remove(const std::string& name)
+void Object::setMembers(const KeyAndEntity* begin, const KeyAndEntity* end)
 {
-    auto it = mEntityByKey.find(name);
-    if (it == mEntityByKey.end()) {
-        return false;
+    mEntities.assign(begin, end);
+    if (auto* index = mIndex.load(std::memory_order_acquire)) {
+        index->rebuild(mEntities);
     }
+}
 
-    auto* ent = it->second;
-    mEntityByKey.erase(it);
-
-    auto it2 = std::find_if(mEntities.begin(), mEntities.end(), [name](const KeyAndEntity& ent) {
-        return ent.mKey == name;
-    });
-    mEntities.erase(it2);
-    delete ent;
+bool Object::remove(std::string_view name)
+{
+    const size_t position = findIndex(name);
+    if (position == std::string::npos) {
+        return false;
+    }
+    destroyChild(unlink(position));
     return true;
 }
 
+Entity* Object::unlink(size_t position)
+{
+    auto* index = mIndex.load(std::memory_order_acquire);
+    const bool rebuild = index && !index->erase(mEntities, position);
+    auto it = mEntities.begin() + position;
+    auto* ent = it->mEntity;
+    it->mKey.release(mArena);
+    mEntities.erase(it);
+    if (rebuild) {
+        index->rebuild(mEntities);
+    }
+    return ent;
+}
+
 Entity* Object::clone() const
 {
+    materialize();
     auto* clone = new Object();
     clone->mEntities.resize(mEntities.size());
     for (size_t i = 0; i < mEntities.size(); i++) {
-        auto childClone = mEntities[i].mEntity->clone();
-        clone->mEntities[i] = KeyAndEntity(mEntities[i].mKey, childClone);
-        clone->mEntityByKey[mEntities[i].mKey] = childClone;
+        const auto key = mEntities[i].mKey.view();
+        auto& cloned = clone->mEntities[i];
+        cloned.mKey.assign(nullptr, key.data(), key.length());
+        cloned.mEntity = mEntities[i].mEntity->clone();
     }
     return clone;
 }
@@ -1131,7 +1848,9 @@ void Object::mergeFrom(const Object& obj, bool overwrite)
     #endif
 }
 
-Boolean::Boolean() {
+Boolean::Boolean(Arena* arena)
+: Entity(arena)
+{
 }
 
 Boolean::~Boolean() {
@@ -1151,6 +1870,11 @@ Entity* Boolean::clone() const {
     return clone;
 }
 
+Null::Null(Arena* arena)
+: Entity(arena)
+{
+}
+
 std::string Null::toString(bool prettyPrint, const std::string& indentation, int level) const {
     return std::string("null");
 }
@@ -1159,17 +1883,57 @@ Entity* Null::clone() const {
     return new Null();
 }
 
+Comment::Comment(Arena* arena)
+: Entity(arena)
+{
+}
+
+Comment::~Comment() {
+    mText.release(mArena);
+}
+
 std::string Comment::toString(bool prettyPrint, const std::string& indentation, int level) const {
-    return std::string("//") + mText;
+    return std::string("//") + std::string(mText.view());
 }
 
 Entity* Comment::clone() const {
     auto* clone = new Comment();
-    clone->mText = mText;
+    const auto text = mText.view();
+    clone->mText.assign(nullptr, text.data(), text.length());
     return clone;
 }
 
-JSON::JSON(std::unique_ptr<Entity> root) : mRoot(std::move(root)) {
+// an object or array of a lazy document, containers are numbered in the order they open
+struct LazyContainer {
+    // position after the closing bracket
+    size_t mEnd;
+    // number of the first container after this one and its children
+    size_t mNext;
+};
+
+// input, settings and container index of a lazily parsed document, owned by its arena
+struct LazyDocument {
+    LazyDocument(const char* text, size_t length, std::vector<LazyContainer>&& containers) :
+        mText(text),
+        mLength(length),
+        mContainers(std::move(containers)) {
+    }
+
+    const char* mText;
+    size_t mLength;
+    bool mAllowComments = false;
+    bool mPreserveNumbers = false;
+    bool mInternStrings = true;
+    size_t mMaxDepth = 0;
+    std::vector<LazyContainer> mContainers;
+    // serializes parsing into the arena on first access
+    mutable std::mutex mMutex;
+};
+
+JSON::JSON(std::shared_ptr<Arena> arena, Entity* root)
+: mArena(std::move(arena)),
+  mRoot(root)
+{
 }
 
 JSON::~JSON() {
@@ -1183,6 +1947,20 @@ const Entity& JSON::root() const {
     return *mRoot;
 }
 
+std::string_view JSON::pooledKey(std::string_view key) const {
+    if (!mArena) {
+        return key;
+    }
+    // lazy containers intern their keys while other threads may read this document
+    std::unique_lock<std::mutex> lock;
+    if (const auto* document = mArena->lazyDocument()) {
+        lock = std::unique_lock<std::mutex>(document->mMutex);
+    }
+    const auto* pool = mArena->findStringPool();
+    const auto pooled = pool ? pool->find(key) : std::string_view();
+    return pooled.data() ? pooled : key;
+}
+
 Object& JSON::object() {
     return mRoot->object();
 }
@@ -1200,13 +1978,43 @@ const Array& JSON::array() const {
 }
 
 JSON JSON::load(const std::string& path, const std::set<Option>& options) {
-    const bool enableCommands = options.find(Option::enableComments) != options.end();
-    return Parser::parseFile(path, enableCommands);
+    Parser parser;
+    parser.allowComments(options.find(Option::enableComments) != options.end());
+    parser.setZeroCopy(options.find(Option::zeroCopy) != options.end());
+    parser.setPreserveNumbers(options.find(Option::preserveNumbers) != options.end());
+    return parser.load(path);
 }
 
 JSON JSON::fromString(const std::string& json, const std::set<Option>& options) {
-    const bool enableCommands = options.find(Option::enableComments) != options.end();
-    return Parser::parseString(json, enableCommands);
+    Parser parser;
+    parser.allowComments(options.find(Option::enableComments) != options.end());
+    parser.setZeroCopy(options.find(Option::zeroCopy) != options.end());
+    parser.setPreserveNumbers(options.find(Option::preserveNumbers) != options.end());
+    return parser.parse(json);
+}
+
+JSON JSON::lazy(const std::string& json, const std::set<Option>& options) {
+    Parser parser;
+    parser.allowComments(options.find(Option::enableComments) != options.end());
+    parser.setPreserveNumbers(options.find(Option::preserveNumbers) != options.end());
+    parser.setLazy(true);
+    return parser.parse(json.data(), json.length());
+}
+
+JSON JSON::lazy(std::string&& json, const std::set<Option>& options) {
+    Parser parser;
+    parser.allowComments(options.find(Option::enableComments) != options.end());
+    parser.setPreserveNumbers(options.find(Option::preserveNumbers) != options.end());
+    parser.setLazy(true);
+    return parser.parse(std::move(json));
+}
+
+JSON JSON::fromString(std::string&& json, const std::set<Option>& options) {
+    Parser parser;
+    parser.allowComments(options.find(Option::enableComments) != options.end());
+    parser.setZeroCopy(options.find(Option::zeroCopy) != options.end());
+    parser.setPreserveNumbers(options.find(Option::preserveNumbers) != options.end());
+    return parser.parse(std::move(json));
 }
 
 void JSON::save(const Entity& entity, const std::string& path, const std::set<Option>& options) const {
@@ -1232,10 +2040,193 @@ std::string JSON::toString(const Entity& entity, const std::set<Option>& options
         indent = "\t";
     }
 
-    return entity.toString(prettyPrint, indent);
+    std::string json;
+    Serializer(json, prettyPrint, indent).write(entity);
+    return json;
+}
+
+
+static inline int countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// returns the first '"' or '\\' in [pos, end) or end if there is none
+static const char* findQuoteOrBackslash(const char* pos, const char* end) {
+#if defined(CSON_AVX2)
+    const __m256i quotes32 = _mm256_set1_epi8('"');
+    const __m256i backslashes32 = _mm256_set1_epi8('\\');
+    while (end - pos >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+        const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quotes32), _mm256_cmpeq_epi8(chunk, backslashes32));
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+        if (mask) {
+            return pos + countTrailingZeros(mask);
+        }
+        pos += 32;
+    }
+#endif
+#if defined(CSON_SSE2)
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    while (end - pos >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(chunk, quotes), _mm_cmpeq_epi8(chunk, backslashes));
+        const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+        if (mask) {
+            return pos + countTrailingZeros(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < end && *pos != '"' && *pos != '\\') {
+        pos++;
+    }
+    return pos;
+}
+
+static inline bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// returns the first character in [pos, end) that is not whitespace or end if there is none
+static const char* findNonWhitespace(const char* pos, const char* end) {
+#if defined(CSON_SSE2)
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i tabs = _mm_set1_epi8('\t');
+    const __m128i returns = _mm_set1_epi8('\r');
+    while (end - pos >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+        const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, spaces), _mm_cmpeq_epi8(chunk, newlines)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, tabs), _mm_cmpeq_epi8(chunk, returns)));
+        const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & 0xffff;
+        if (mask) {
+            return pos + countTrailingZeros(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < end && isWhitespace(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+
+// Stage 1 of DOM parsing: classifies 64 bytes at a time into bit masks and
+// records the positions of all tokens, i.e. the structural characters {}[]:,
+// outside of strings, the opening quotes of strings and the first character
+// of numbers and literals. Stage 2 then jumps from token to token.
+struct StructuralBlock {
+    uint64_t mQuote = 0;
+    uint64_t mBackslash = 0;
+    uint64_t mOperator = 0;
+    uint64_t mWhitespace = 0;
+};
+
+#if defined(CSON_AVX2)
+static inline void classify32(const char* pos, int shift, StructuralBlock& block) {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+    // '[' and ']' differ from '{' and '}' only in bit 0x20
+    const __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    const __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+    const __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+    block.mQuote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))))) << shift;
+    block.mBackslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))))) << shift;
+    block.mOperator |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << shift;
+    block.mWhitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << shift;
+}
+#elif defined(CSON_SSE2)
+static inline void classify16(const char* pos, int shift, StructuralBlock& block) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+    // '[' and ']' differ from '{' and '}' only in bit 0x20
+    const __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    const __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+    const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+                                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+    block.mQuote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))))) << shift;
+    block.mBackslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))))) << shift;
+    block.mOperator |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(op))) << shift;
+    block.mWhitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(ws))) << shift;
+}
+#endif
+
+static inline StructuralBlock classifyBlock(const char* pos) {
+    StructuralBlock block;
+#if defined(CSON_AVX2)
+    classify32(pos, 0, block);
+    classify32(pos + 32, 32, block);
+#elif defined(CSON_SSE2)
+    classify16(pos, 0, block);
+    classify16(pos + 16, 16, block);
+    classify16(pos + 32, 32, block);
+    classify16(pos + 48, 48, block);
+#else
+    for (int i = 0; i < 64; i++) {
+        const uint64_t bit = uint64_t(1) << i;
+        switch (pos[i]) {
+        case '"': block.mQuote |= bit; break;
+        case '\\': block.mBackslash |= bit; break;
+        case '{': case '}': case '[': case ']': case ':': case ',': block.mOperator |= bit; break;
+        case ' ': case '\n': case '\t': case '\r': block.mWhitespace |= bit; break;
+        default: break;
+        }
+    }
+#endif
+    return block;
+}
+
+// bit i is the xor of bits 0...i, turns quote positions into string ranges
+static inline uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+static inline int countBits64(uint64_t mask) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(mask));
+#else
+    return __builtin_popcountll(mask);
+#endif
+}
+
+static inline int countTrailingZeros64(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// characters preceded by an odd number of backslashes, prevEscaped carries into the next block
+static inline uint64_t findEscaped(uint64_t backslash, uint64_t& prevEscaped) {
+    // a backslash escaped at the end of the previous block does not escape
+    backslash &= ~prevEscaped;
+    const uint64_t followsEscape = (backslash << 1) | prevEscaped;
+    // runs of backslashes starting on an odd bit carry into the bit after the run
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    const uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+    const uint64_t sequencesStartingOnEvenBits = oddSequenceStarts + backslash;
+    prevEscaped = sequencesStartingOnEvenBits < backslash ? 1 : 0;
+    const uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+    return (evenBits ^ invertMask) & followsEscape;
 }
 
-
 Parser::Parser(){
 }
 
@@ -1250,14 +2241,87 @@ void Parser::setMaxDepth(size_t maxDepth) {
     mMaxDepth = maxDepth;
 }
 
+void Parser::setZeroCopy(bool zeroCopy) {
+    mZeroCopy = zeroCopy;
+}
+
+void Parser::setPreserveNumbers(bool preserve) {
+    mPreserveNumbers = preserve;
+}
+
+void Parser::setInternStrings(bool intern) {
+    mInternStrings = intern;
+}
+
+void Parser::setLazy(bool lazy) {
+    mLazy = lazy;
+}
+
+void Parser::setThreads(size_t threads) {
+    mThreads = threads;
+}
+
+void Parser::setProjection(const std::vector<std::string>& paths) {
+    mProjection.clear();
+    if (paths.empty()) {
+        return;
+    }
+
+    mProjection.emplace_back();
+    for (const auto& path : paths) {
+        size_t node = 0;
+        size_t start = 0;
+        while (!mProjection[node].mComplete) {
+            const size_t end = std::min(path.find('.', start), path.length());
+            const std::string key = path.substr(start, end - start);
+
+            size_t child = 0;
+            for (const auto& existing : mProjection[node].mChildren) {
+                if (existing.first == key) {
+                    child = existing.second;
+                }
+            }
+            if (child == 0) {
+                child = mProjection.size();
+                mProjection[node].mChildren.emplace_back(key, child);
+                mProjection.emplace_back();
+            }
+
+            node = child;
+            if (end == path.length()) {
+                // a shorter path keeps everything below it
+                mProjection[node].mComplete = true;
+                mProjection[node].mChildren.clear();
+            }
+            start = end + 1;
+        }
+    }
+}
+
+const Parser::ProjectionNode* Parser::projectedMember(const ProjectionNode& node, std::string_view key) const {
+    for (const auto& child : node.mChildren) {
+        if (child.first == key) {
+            return &mProjection[child.second];
+        }
+    }
+    return nullptr;
+}
+
+std::string_view Parser::scanKey() {
+    Arena* arena = mArena;
+    mArena = nullptr;
+    const auto key = parseKey();
+    mArena = arena;
+    return key;
+}
+
 void Parser::skipWhitespaces() {
-    while ( mPosition < mLength
-           &&
-           (mText[mPosition] == ' '
-            || mText[mPosition] == '\t'
-            || mText[mPosition] == '\r'
-            || mText[mPosition] == '\n')) {
+    // single separating spaces are the common case, longer runs (indentation) are skipped 16 bytes at a time
+    if (mPosition < mLength && isWhitespace(mText[mPosition])) {
         mPosition++;
+        if (mPosition < mLength && isWhitespace(mText[mPosition])) {
+            mPosition = findNonWhitespace(mText + mPosition, mText + mLength) - mText;
+        }
     }
 }
 
@@ -1275,6 +2339,10 @@ char Parser::curChar(bool increment) {
 
 
 bool Parser::tryToConsume(const char* txt) {
+    // most calls fail on the first character
+    if (mPosition == mLength || mText[mPosition] != txt[0]) {
+        return false;
+    }
     size_t storedPos = mPosition;
     int i = 0;
     bool found = false;
@@ -1322,142 +2390,528 @@ static int writeUTF8Chars(char* buf, short unsigned int c) {
     }
 }
 
-// NOTE: does NOT support empty strings, caller needs to check that!
-std::string Parser::parseStringLiteral() {
-    std::string str;
-    str.reserve(1024);
+static int utf8Length(short unsigned int c) {
+    return c < 128 ? 1 : (c < 2048 ? 2 : 3);
+}
+
+static int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// returns the value of 4 hex digits or -1 if any of them is invalid
+static int parseHex4(const char* txt) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        const int digit = hexDigitValue(txt[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+static char unescapeChar(char c) {
+    switch (c) {
+    case 'b': return '\b';
+    case 'r': return '\r';
+    case 'n': return '\n';
+    case 'f': return '\f';
+    case 't': return '\t';
+    default: return c; // '\\', '/', '"' and unknown escapes map to the character itself
+    }
+}
+
+std::string_view Parser::parseKey(size_t maxInternedLength) {
+    if (mPosition == mLength || mText[mPosition] != '"') {
+        throw ParseError(mText, mLength, mPosition, "Syntax error: Expected '\"' at position %d", static_cast<int>(mPosition));
+    }
+    return parseStringLiteral(maxInternedLength);
+}
 
+// NOTE: does NOT support empty strings, caller needs to check that!
+// The returned view points into the arena of the parsed document. Without an
+// arena (event parsing) it points into the input or mStringBuffer and is only
+// valid until the next call. Strings up to maxInternedLength are taken from the string pool.
+std::string_view Parser::parseStringLiteral(size_t maxInternedLength) {
     tryToConsume("\""); // NOTE: required because caller *may* have consumed this already, but does not have to. NOTE that due to this, we cannot support empty strings (this call would consume the closing \")
-    size_t origPos = mPosition;
-    char c = mText[mPosition];
-    while (c != '\"') {
-        if (mPosition == mLength) {
+    const size_t origPos = mPosition;
+    const char* begin = mText + mPosition;
+    const char* end = mText + mLength;
+
+    // first pass: find the closing quote and the exact length of the decoded string
+    size_t decodedLength = 0;
+    bool hasEscapes = false;
+    const char* pos = begin;
+    const char* runStart = begin;
+    while (true) {
+        pos = findQuoteOrBackslash(pos, end);
+        if (pos == end) {
             throw ParseError(mText, mLength, origPos, "Closing \" not found");
         }
+        if (*pos == '"') {
+            break;
+        }
 
-        if (c == '\\'
-            && mPosition + 1 < mLength) {
-            mPosition++;
-            c = mText[mPosition];
-            switch (c) {
-            case 'b': c = '\b'; break;
-            case 'r': c = '\r'; break;
-            case 'n': c = '\n'; break;
-            case 'f': c = '\f'; break;
-            case 't': c = '\t'; break;
-            case '\\': c = '\\'; break;
-            case '/': c = '/'; break;
-            case '\"': c = '\"'; break;
-            case 'u': {
-                    mPosition++;
-                    if (mPosition + 4 > mLength) {
-                        throw ParseError(mText, mLength, origPos, "Invalid \\u escaping");
-                    }
-                    char buf[5];
-                    memcpy(buf, &mText[mPosition], 4);
-                    buf[4] = 0;
-                    int utf8Char = (int)strtol(buf, NULL, 16);
-                    char utf8Buf[16];
-                    int len = writeUTF8Chars(utf8Buf, utf8Char);
-                    for (int i = 0; i < len-1; i++) {
-                        str += utf8Buf[i];
-                    }
-                    c = utf8Buf[len-1];
-                    mPosition += 3;
-                }
-                break;
+        hasEscapes = true;
+        decodedLength += pos - runStart;
+        if (pos + 1 == end) {
+            throw ParseError(mText, mLength, origPos, "Closing \" not found");
+        }
+        if (pos[1] == 'u') {
+            const int utf16Char = end - pos >= 6 ? parseHex4(pos + 2) : -1;
+            if (utf16Char < 0) {
+                throw ParseError(mText, mLength, origPos, "Invalid \\u escaping");
             }
+            decodedLength += utf8Length(utf16Char);
+            pos += 6;
+        } else {
+            decodedLength += 1;
+            pos += 2;
         }
-        str += c;
-        mPosition++;
-        if (mPosition == mLength) {
-            throw ParseError(mText, mLength, origPos, "Closing \" not found");
+        runStart = pos;
+    }
+    const char* closingQuote = pos;
+    decodedLength += closingQuote - runStart;
+    mPosition = closingQuote - mText + 1;
+
+    const bool intern = mArena && mInternStrings && decodedLength <= maxInternedLength;
+    if (!hasEscapes) {
+        if (intern) {
+            return mArena->stringPool().intern(std::string_view(begin, decodedLength), mZeroCopy);
         }
-        c = mText[mPosition];
+        const bool reference = mZeroCopy || !mArena;
+        return std::string_view(reference ? begin : mArena->copyString(begin, decodedLength), decodedLength);
     }
-    mPosition++;
-    return str;
+
+    // second pass: copy the runs between escapes into a buffer of the final size
+    char* decoded = nullptr;
+    if (mArena && !intern) {
+        decoded = static_cast<char*>(mArena->allocate(decodedLength, 1));
+    } else {
+        mStringBuffer.resize(decodedLength);
+        decoded = &mStringBuffer[0];
+    }
+    char* out = decoded;
+    pos = begin;
+    while (true) {
+        const char* next = findQuoteOrBackslash(pos, closingQuote);
+        memcpy(out, pos, next - pos);
+        out += next - pos;
+        if (next == closingQuote) {
+            break;
+        }
+
+        if (next[1] == 'u') {
+            out += writeUTF8Chars(out, parseHex4(next + 2));
+            pos = next + 6;
+        } else {
+            *out++ = unescapeChar(next[1]);
+            pos = next + 2;
+        }
+    }
+    const std::string_view result(decoded, decodedLength);
+    return intern ? mArena->stringPool().intern(result) : result;
 }
 
-Comment* Parser::parseComment() {
+// returns the text of a comment after the leading //, the newline is consumed but not returned
+std::string_view Parser::scanComment() {
     if (!mAllowComments) {
         throw ParseError(mText, mLength, mPosition, "Comments are disabled");
     }
 
-    std::string text;
+    const size_t start = mPosition;
+    size_t end = mPosition;
     while (mPosition < mLength) {
         const auto c = curChar();
         if (c == '\n') {
             break;
         }
-        text += c;
+        end = mPosition;
     }
+    return std::string_view(mText + start, end - start);
+}
 
-    auto comment = std::make_unique<Comment>();
-    comment->mText = text;
-    return comment.release();
+Comment* Parser::parseComment() {
+    const auto text = scanComment();
+    auto* comment = Entity::create<Comment>(mArena);
+    if (mZeroCopy) {
+        comment->mText.reference(text.data(), text.length());
+    } else {
+        comment->mText.assign(mArena, text.data(), text.length());
+    }
+    return comment;
 }
 
-Entity* Parser::parseValue(size_t depth) {
-    Entity* data = nullptr;
-    if (tryToConsume("\"")) {
-        if (tryToConsume("\"")) {
-            // special case: empty string
-            String* s = new String();
-            s->setString(std::string());
-            data = s;
-        } else {
-            data = parseString();
-        }
-    } else if (tryToConsume("[")) {
-        data = parseArray(depth + 1);
-    } else if (tryToConsume("{")) {
-        data = parseObject(depth + 1);
-    } else if (tryToConsume("true")) {
-        auto* b = new Boolean();
+// records the end of every container while a lazy document is validated
+class LazyIndexer final : public Handler {
+public:
+    explicit LazyIndexer(const Parser& parser) :
+        mParser(parser) {
+    }
+
+    bool startObject() override { return start(); }
+    bool endObject() override { return end(); }
+    bool startArray() override { return start(); }
+    bool endArray() override { return end(); }
+
+    std::vector<LazyContainer> mContainers;
+
+private:
+    bool start() {
+        mOpen.push_back(mContainers.size());
+        mContainers.push_back({0, 0});
+        return true;
+    }
+
+    bool end() {
+        auto& container = mContainers[mOpen.back()];
+        mOpen.pop_back();
+        container.mEnd = mParser.mPosition;
+        container.mNext = mContainers.size();
+        return true;
+    }
+
+    const Parser& mParser;
+    std::vector<size_t> mOpen;
+};
+
+// position of the members of a lazy object or array, after the opening bracket
+struct LazySource {
+    const LazyDocument* mDocument;
+    size_t mPosition;
+    size_t mDepth;
+    size_t mContainer;
+};
+
+// the index of the document gives the end of the container, its text is not scanned again
+template<class T>
+T* Parser::parseLazy(size_t depth) {
+    auto* container = Entity::create<T>(mArena);
+    auto* source = new (mArena->allocate(sizeof(LazySource), alignof(LazySource))) LazySource{mLazyDocument, mPosition, depth, mLazyContainer};
+    container->mLazy.store(source, std::memory_order_relaxed);
+    const auto& indexed = mLazyDocument->mContainers[mLazyContainer];
+    mPosition = indexed.mEnd;
+    mLazyContainer = indexed.mNext;
+    return container;
+}
+
+// returns the position after the closing quote of a string, pos follows the opening quote
+static const char* skipString(const char* pos, const char* end) {
+    while (true) {
+        pos = findQuoteOrBackslash(pos, end);
+        if (pos >= end || *pos == '"') {
+            break;
+        }
+        pos += 2; // escaped character
+    }
+    return std::min(pos + 1, end);
+}
+
+void Parser::skipContainer() {
+    const char* pos = mText + mPosition;
+    const char* end = mText + mLength;
+    size_t depth = 1;
+    while (depth > 0 && pos < end) {
+        switch (*pos++) {
+        case '"':
+            pos = skipString(pos, end);
+            break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            depth--;
+            break;
+        case '/': {
+                // the input is validated, slashes outside of strings start comments
+                const void* newline = memchr(pos, '\n', end - pos);
+                pos = newline ? static_cast<const char*>(newline) + 1 : end;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    mPosition = std::min(pos, end) - mText;
+}
+
+void Parser::skipValue() {
+    switch (curChar(false)) {
+    case '[':
+    case '{':
+        mPosition++;
+        skipContainer();
+        break;
+    case '"':
+        mPosition = skipString(mText + mPosition + 1, mText + mLength) - mText;
+        break;
+    default:
+        // numbers and literals end at the next separator
+        while (mPosition < mLength) {
+            const char c = mText[mPosition];
+            if (c == ',' || c == ']' || c == '}' || isWhitespace(c)) {
+                break;
+            }
+            mPosition++;
+        }
+        break;
+    }
+}
+
+// NOTE: the scan only finds the element boundaries, each element is validated by the worker parsing it
+Array* Parser::parseArrayParallel() {
+    struct Chunk {
+        size_t mBegin;
+        size_t mEnd; // the ',' or ']' after the last element
+        std::vector<Entity*> mValues;
+        std::exception_ptr mError;
+    };
+
+    const size_t threads = mThreads ? mThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    // several chunks per thread even out differences in element size
+    const size_t chunkLength = std::max(mLength / (threads * 4), s_MinParallelLength / 16);
+
+    auto* arr = Entity::create<Array>(mArena);
+    skipWhitespaces();
+    if (tryToConsume("]")) {
+        return arr;
+    }
+
+    std::vector<Chunk> chunks;
+    size_t begin = mPosition;
+    while (true) {
+        skipWhitespaces();
+        skipValue();
+        skipWhitespaces();
+        const size_t end = mPosition;
+        const bool last = !tryToConsume(",");
+        if (last) {
+            consumeOrDie("]");
+        }
+        if (last || end - begin >= chunkLength) {
+            chunks.push_back(Chunk{begin, end, {}, nullptr});
+            begin = mPosition;
+        }
+        if (last) {
+            break;
+        }
+    }
+
+    // each thread allocates from its own arena, kept alive by the document arena.
+    // It is shared like document arenas, so elements can be taken out of the array.
+    const size_t workerCount = std::min(threads, chunks.size());
+    std::vector<std::shared_ptr<Arena>> arenas;
+    for (size_t i = 0; i < workerCount; i++) {
+        arenas.push_back(std::make_shared<Arena>());
+        mArena->retain(arenas.back());
+    }
+
+    std::atomic<size_t> nextChunk(0);
+    // failures outside of a chunk, one per worker
+    std::vector<std::exception_ptr> errors(workerCount);
+    auto work = [this, &chunks, &nextChunk, &arenas, &errors](size_t worker) {
+        try {
+            Parser parser;
+            parser.mText = mText;
+            parser.mLength = mLength;
+            parser.mZeroCopy = mZeroCopy;
+            parser.mPreserveNumbers = mPreserveNumbers;
+            parser.mInternStrings = mInternStrings;
+            parser.mMaxDepth = mMaxDepth;
+            parser.mProjection = mProjection;
+            parser.mProjectionNode = mProjection.empty() ? nullptr : &parser.mProjection[0];
+            parser.mArena = arenas[worker].get();
+
+            for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+                auto& chunk = chunks[i];
+                try {
+                    parser.mPosition = chunk.mBegin;
+                    while (true) {
+                        parser.skipWhitespaces();
+                        chunk.mValues.push_back(parser.parseValue(1));
+                        parser.skipWhitespaces();
+                        if (parser.mPosition >= chunk.mEnd) {
+                            break;
+                        }
+                        parser.consumeOrDie(",");
+                    }
+                    if (parser.mPosition != chunk.mEnd) {
+                        throw ParseError(mText, mLength, parser.mPosition, "Syntax error");
+                    }
+                } catch (...) {
+                    chunk.mError = std::current_exception();
+                }
+            }
+        } catch (...) {
+            errors[worker] = std::current_exception();
+        }
+    };
+
+    // the workers reference the chunks, they are joined before anything is thrown
+    std::vector<std::thread> workers;
+    try {
+        for (size_t i = 1; i < workerCount; i++) {
+            workers.emplace_back(work, i);
+        }
+    } catch (...) {
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        throw;
+    }
+    work(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    size_t count = 0;
+    for (const auto& chunk : chunks) {
+        if (chunk.mError) {
+            std::rethrow_exception(chunk.mError);
+        }
+        count += chunk.mValues.size();
+    }
+    arr->mValues.reserve(count);
+    for (const auto& chunk : chunks) {
+        arr->mValues.insert(arr->mValues.end(), chunk.mValues.begin(), chunk.mValues.end());
+    }
+    return arr;
+}
+
+void Parser::expand(Entity& container, const LazySource& source) {
+    const auto& document = *source.mDocument;
+    Parser parser;
+    parser.mText = document.mText;
+    parser.mLength = document.mLength;
+    parser.mPosition = source.mPosition;
+    parser.mAllowComments = document.mAllowComments;
+    parser.mPreserveNumbers = document.mPreserveNumbers;
+    parser.mInternStrings = document.mInternStrings;
+    parser.mMaxDepth = document.mMaxDepth;
+    parser.mZeroCopy = true;
+    parser.mLazy = true;
+    parser.mLazyDocument = &document;
+    parser.mLazyContainer = source.mContainer + 1;
+    parser.mArena = container.arena();
+    if (container.type() == Entity::Type::object) {
+        parser.parseObject(source.mDepth, static_cast<Object*>(&container));
+    } else {
+        parser.parseArray(source.mDepth, static_cast<Array*>(&container));
+    }
+}
+
+void Object::expand() const {
+    const auto* source = mLazy.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(source->mDocument->mMutex);
+    if (mLazy.load(std::memory_order_acquire)) {
+        Parser::expand(const_cast<Object&>(*this), *source);
+        mLazy.store(nullptr, std::memory_order_release);
+    }
+}
+
+void Array::expand() const {
+    const auto* source = mLazy.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(source->mDocument->mMutex);
+    if (mLazy.load(std::memory_order_acquire)) {
+        Parser::expand(const_cast<Array&>(*this), *source);
+        mLazy.store(nullptr, std::memory_order_release);
+    }
+}
+
+Entity* Parser::parseValue(size_t depth) {
+    Entity* data = nullptr;
+    // the first character decides the type
+    switch (mPosition < mLength ? mText[mPosition] : '\0') {
+    case '"':
+        mPosition++;
+        if (tryToConsume("\"")) {
+            // special case: empty string
+            data = Entity::create<String>(mArena);
+        } else {
+            data = parseString();
+        }
+        break;
+    case '[':
+        mPosition++;
+        data = mLazy ? parseLazy<Array>(depth + 1) : parseArray(depth + 1);
+        break;
+    case '{':
+        mPosition++;
+        data = mLazy ? parseLazy<Object>(depth + 1) : parseObject(depth + 1);
+        break;
+    case 't': {
+        consumeOrDie("true");
+        auto* b = Entity::create<Boolean>(mArena);
         b->setBool(true);
         data = b;
-    } else if (tryToConsume("false")) {
-        auto* b = new Boolean();
+        break;
+    }
+    case 'f': {
+        consumeOrDie("false");
+        auto* b = Entity::create<Boolean>(mArena);
         b->setBool(false);
         data = b;
-    } else if (tryToConsume("null")) {
-        data = new Null();
-    } else {
+        break;
+    }
+    case 'n':
+        consumeOrDie("null");
+        data = Entity::create<Null>(mArena);
+        break;
+    default:
         data = parseNumber();
+        break;
     }
     return data;
 }
 
-Array* Parser::parseArray(size_t depth) {
+// NOTE: entities are allocated in mArena, on errors they are released together with the arena
+Array* Parser::parseArray(size_t depth, Array* arr) {
     if (depth > mMaxDepth) {
         throw TooManyNestings(mText, mLength, mPosition);
     }
 
-    auto arr = std::make_unique<Array>();
+    if (!arr) {
+        arr = Entity::create<Array>(mArena);
+    }
+    const size_t stackStart = mValueStack.size();
     while (true) {
         skipWhitespaces();
 
         if (tryToConsume("//")) {
             auto* comment = parseComment();
-            arr->mValues.push_back(comment);
+            mValueStack.push_back(comment);
             skipWhitespaces();
         }
 
         // empty array?
-        if (arr->count() == 0
+        if (mValueStack.size() == stackStart
             && tryToConsume("]")) {
             break;
         }
 
         auto* ent = parseValue(depth);
-        arr->mValues.push_back(ent);
+        mValueStack.push_back(ent);
 
         skipWhitespaces();
 
         if (tryToConsume("//")) {
             auto* comment = parseComment();
-            arr->mValues.push_back(comment);
+            mValueStack.push_back(comment);
             skipWhitespaces();
         }
 
@@ -1466,44 +2920,78 @@ Array* Parser::parseArray(size_t depth) {
             break;
         }
     }
-    return arr.release();
+
+    arr->mValues.assign(mValueStack.begin() + stackStart, mValueStack.end());
+    mValueStack.resize(stackStart);
+    return arr;
 }
 
-Object* Parser::parseObject(size_t depth) {
+Object* Parser::parseObject(size_t depth, Object* obj) {
     if (depth > mMaxDepth) {
         throw TooManyNestings(mText, mLength, mPosition);
     }
 
-    auto obj = std::make_unique<Object>();
+    if (!obj) {
+        obj = Entity::create<Object>(mArena);
+    }
+    const size_t stackStart = mMemberStack.size();
+    const ProjectionNode* projection = mProjectionNode;
+    Object::KeyAndEntity member;
+    // skipped members are not on the stack, its size does not tell if a member was read
+    bool first = true;
     while (true) {
         skipWhitespaces();
 
         // empty object?
-        if (obj->count() == 0
+        if (first
             && tryToConsume("}")) {
             break;
         }
+        first = false;
 
         if (tryToConsume("//")) {
-            auto* comment = parseComment();
-            obj->mEntities.push_back(Object::KeyAndEntity("", comment));
+            member.mKey = StringData();
+            member.mEntity = parseComment();
+            mMemberStack.push_back(member);
             skipWhitespaces();
         }
 
-        std::string key = parseStringLiteral();
-        skipWhitespaces();
-        consumeOrDie(":");
-        skipWhitespaces();
-        auto* ent = parseValue(depth);
+        // members outside of the projection are skipped before their key is copied
+        const ProjectionNode* child = nullptr;
+        bool skipped = false;
+        if (projection) {
+            const size_t keyStart = mPosition;
+            child = projectedMember(*projection, scanKey());
+            skipWhitespaces();
+            consumeOrDie(":");
+            skipWhitespaces();
+            const char c = curChar(false);
+            skipped = !child || (!child->mComplete && c != '{' && c != '[');
+            if (skipped) {
+                skipValue();
+            } else {
+                mPosition = keyStart;
+            }
+        }
 
-        obj->mEntities.push_back(Object::KeyAndEntity(key, ent));
-        obj->mEntityByKey[key] = ent;
+        if (!skipped) {
+            const auto key = parseKey(SIZE_MAX);
+            member.mKey.reference(key.data(), key.length());
+            skipWhitespaces();
+            consumeOrDie(":");
+            skipWhitespaces();
+            mProjectionNode = child && !child->mComplete ? child : nullptr;
+            member.mEntity = parseValue(depth);
+            mProjectionNode = projection;
+            mMemberStack.push_back(member);
+        }
 
         skipWhitespaces();
 
         if (tryToConsume("//")) {
-            auto* comment = parseComment();
-            obj->mEntities.push_back(Object::KeyAndEntity("", comment));
+            member.mKey = StringData();
+            member.mEntity = parseComment();
+            mMemberStack.push_back(member);
             skipWhitespaces();
         }
 
@@ -1513,91 +3001,325 @@ Object* Parser::parseObject(size_t depth) {
         }
     }
 
+    obj->setMembers(mMemberStack.data() + stackStart, mMemberStack.data() + mMemberStack.size());
+    mMemberStack.resize(stackStart);
+    return obj;
+}
+
+// stage 1 of DOM parsing, indexes the next window of the input when stage 2 runs out of tokens
+void Parser::indexTokens() {
+    // keep the tokens not consumed yet
+    std::copy(mTokens.begin() + mNextToken, mTokens.begin() + mTokenCount, mTokens.begin());
+    uint32_t* out = mTokens.data() + (mTokenCount - mNextToken);
+    mNextToken = 0;
+    const bool firstWindow = mIndexedLength == 0;
+    // a window may end inside a long string, continue until the next token is known too
+    for (size_t blocks = 0; mIndexedLength < mLength && (blocks < s_TokenWindowBlocks || out < mTokens.data() + 2); ++blocks) {
+        StructuralBlock block;
+        if (mLength - mIndexedLength >= 64) {
+            block = classifyBlock(mText + mIndexedLength);
+        } else {
+            // the last block is padded with spaces
+            char padded[64];
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, mText + mIndexedLength, mLength - mIndexedLength);
+            block = classifyBlock(padded);
+        }
+        const uint64_t quote = block.mQuote & ~findEscaped(block.mBackslash, mPrevEscaped);
+        // set from the opening quote up to, but not including, the closing quote
+        const uint64_t inString = prefixXor(quote) ^ mPrevInString;
+        mPrevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+        if (firstWindow) {
+            mStringBytes += countBits64(inString);
+        }
+
+        const uint64_t scalar = ~(block.mOperator | block.mWhitespace | quote | inString);
+        const uint64_t scalarStart = scalar & ~((scalar << 1) | mPrevScalar);
+        mPrevScalar = scalar >> 63;
+
+        uint64_t tokens = (block.mOperator & ~inString) | (quote & inString) | scalarStart;
+        while (tokens) {
+            *out++ = static_cast<uint32_t>(mIndexedLength + countTrailingZeros64(tokens));
+            tokens &= tokens - 1;
+        }
+        mIndexedLength += 64;
+    }
+    mTokenCount = out - mTokens.data();
+    if (mIndexedLength >= mLength) {
+        // stage 2 stops at the end of the input
+        while (mTokenCount < 2) {
+            mTokens[mTokenCount++] = static_cast<uint32_t>(mLength);
+        }
+    }
+}
+
+// the token after the current one is always indexed so endScalar() can look at it
+void Parser::nextToken() {
+    if (mNextToken + 1 >= mTokenCount) {
+        indexTokens();
+    }
+    mPosition = mTokens[mNextToken++];
+}
+
+// numbers and literals end at whitespace or at the next token
+void Parser::endScalar() {
+    if (mPosition < mLength && mPosition != mTokens[mNextToken] && !isWhitespace(mText[mPosition])) {
+        throw ParseError(mText, mLength, mPosition, "Syntax error");
+    }
+}
+
+// NOTE: mirrors parseValue(), parseArray() and parseObject() but moves between the tokens of stage 1
+Entity* Parser::parseIndexedValue(size_t depth) {
+    switch (mPosition < mLength ? mText[mPosition] : '\0') {
+    case '"':
+        if (mPosition + 1 < mLength && mText[mPosition + 1] == '"') {
+            // special case: empty string
+            return Entity::create<String>(mArena);
+        }
+        mPosition++;
+        return parseString();
+    case '[':
+        return parseIndexedArray(depth + 1);
+    case '{':
+        return parseIndexedObject(depth + 1);
+    case 't': {
+        consumeOrDie("true");
+        endScalar();
+        auto* b = Entity::create<Boolean>(mArena);
+        b->setBool(true);
+        return b;
+    }
+    case 'f': {
+        consumeOrDie("false");
+        endScalar();
+        auto* b = Entity::create<Boolean>(mArena);
+        b->setBool(false);
+        return b;
+    }
+    case 'n':
+        consumeOrDie("null");
+        endScalar();
+        return Entity::create<Null>(mArena);
+    default: {
+        auto* num = parseNumber();
+        endScalar();
+        return num;
+    }
+    }
+}
+
+Array* Parser::parseIndexedArray(size_t depth) {
+    if (depth > mMaxDepth) {
+        throw TooManyNestings(mText, mLength, mPosition);
+    }
+
+    auto* arr = Entity::create<Array>(mArena);
+    nextToken();
+    // empty array?
+    if (mPosition < mLength && mText[mPosition] == ']') {
+        return arr;
+    }
+
+    const size_t stackStart = mValueStack.size();
+    while (true) {
+        mValueStack.push_back(parseIndexedValue(depth));
+        nextToken();
+        const char c = mPosition < mLength ? mText[mPosition] : '\0';
+        if (c == ']') {
+            break;
+        }
+        if (c != ',') {
+            throw ParseError(mText, mLength, mPosition, "Syntax error: Expected ',' or ']' at position %d", static_cast<int>(mPosition));
+        }
+        nextToken();
+    }
+
+    arr->mValues.assign(mValueStack.begin() + stackStart, mValueStack.end());
+    mValueStack.resize(stackStart);
+    return arr;
+}
+
+Object* Parser::parseIndexedObject(size_t depth) {
+    if (depth > mMaxDepth) {
+        throw TooManyNestings(mText, mLength, mPosition);
+    }
+
+    auto* obj = Entity::create<Object>(mArena);
+    nextToken();
+    // empty object?
+    if (mPosition < mLength && mText[mPosition] == '}') {
+        return obj;
+    }
+
+    const size_t stackStart = mMemberStack.size();
+    Object::KeyAndEntity member;
+    while (true) {
+        const auto key = parseKey(SIZE_MAX);
+        member.mKey.reference(key.data(), key.length());
+        nextToken();
+        if (mPosition == mLength || mText[mPosition] != ':') {
+            throw ParseError(mText, mLength, mPosition, "Syntax error: Expected ':' at position %d", static_cast<int>(mPosition));
+        }
+        nextToken();
+        member.mEntity = parseIndexedValue(depth);
+        mMemberStack.push_back(member);
+
+        nextToken();
+        const char c = mPosition < mLength ? mText[mPosition] : '\0';
+        if (c == '}') {
+            break;
+        }
+        if (c != ',') {
+            throw ParseError(mText, mLength, mPosition, "Syntax error: Expected ',' or '}' at position %d", static_cast<int>(mPosition));
+        }
+        nextToken();
+    }
 
-    return obj.release();
+    obj->setMembers(mMemberStack.data() + stackStart, mMemberStack.data() + mMemberStack.size());
+    mMemberStack.resize(stackStart);
+    return obj;
 }
 
-void Parser::readDigits(std::string& dest) {
+void Parser::readDigits() {
     while (mPosition < mLength) {
         char c = mText[mPosition];
         if (c < '0' || c > '9') {
             break;
         }
-        dest += c;
         mPosition++;
     }
 }
 
-Number* Parser::parseNumber() {
-    auto num = std::make_unique<Number>();
-    std::string str;
-    str.reserve(32);
+// validates a number in place and returns its text
+std::string_view Parser::scanNumber() {
+    const size_t start = mPosition;
 
-    if (tryToConsume("-")) {
-        str += "-";
-    }
+    tryToConsume("-");
 
-    if (tryToConsume("0")) {
-        str += "0";
-    } else {
+    if (!tryToConsume("0")) {
         const char c = curChar();
         if (c < '1' || c > '9') {
             throw ParseError(mText, mLength, mPosition, "Expecting digit 1...9");
         }
 
-        str += c;
-        readDigits(str);
+        readDigits();
     }
 
     // optional fraction part
     if (tryToConsume(".")) {
-        str += ".";
-        readDigits(str);
+        readDigits();
     }
 
     // optional exponent part
     char c = curChar(false);
     if (c == 'e' || c == 'E') {
-        str += c;
         mPosition++;
 
         c = curChar();
         if (c != '+' && c != '-') {
             throw ParseError(mText, mLength, mPosition, "Expecting + or -");
         }
-        str += c;
 
-        readDigits(str);
+        readDigits();
+    }
+
+    return std::string_view(mText + start, mPosition - start);
+}
+
+Number* Parser::parseNumber() {
+    const auto text = scanNumber();
+    auto* num = Entity::create<Number>(mArena);
+    num->setParsed(text);
+    if (!mPreserveNumbers) {
+        return num;
     }
 
-    num->mNumber = str;
-    return num.release();
+    if (mZeroCopy) {
+        num->mNumber.reference(text.data(), text.length());
+    } else {
+        num->mNumber.assign(mArena, text.data(), text.length());
+    }
+    return num;
 }
 
 
 // NOTE: does NOT support empty strings, caller needs to check that!
 String* Parser::parseString() {
-    std::string str = parseStringLiteral();
-    auto* s = new String();
-    s->setString(str);
+    const auto str = parseStringLiteral(s_MaxInternedValueLength);
+    auto* s = Entity::create<String>(mArena);
+    s->mValue.reference(str.data(), str.length());
     return s;
 }
 
 JSON Parser::parse(const char* txt, size_t length) {
     mText = txt;
     mLength = length;
+    return parseDocument(std::make_unique<Arena>());
+}
+
+JSON Parser::parseDocument(std::unique_ptr<Arena> arena) {
+    if (mLazy) {
+        // errors are reported now, later accesses only parse validated input
+        LazyIndexer indexer(*this);
+        parse(mText, mLength, indexer);
+        auto* document = arena->own(new LazyDocument(mText, mLength, std::move(indexer.mContainers)));
+        document->mAllowComments = mAllowComments;
+        document->mPreserveNumbers = mPreserveNumbers;
+        document->mInternStrings = mInternStrings;
+        document->mMaxDepth = mMaxDepth;
+        arena->setLazyDocument(document);
+        mLazyDocument = document;
+        mLazyContainer = 0;
+    }
+
     mPosition = 0;
+    mValueStack.clear();
+    mMemberStack.clear();
+    mArena = arena.get();
+    mProjectionNode = mProjection.empty() || mLazy ? nullptr : &mProjection[0];
 
-    std::unique_ptr<Entity> root;
+    Entity* root = nullptr;
     skipWhitespaces();
     if (mPosition == mLength) {
         throw ParseError(mText, mLength, mPosition, "Empty input");
     }
 
-    if (tryToConsume("[")) {
-        root.reset(parseArray(1));
+    const bool parallel = mThreads != 1 && !mLazy && !mAllowComments && mLength >= s_MinParallelLength;
+    // comments, projections and lazy containers are handled by the parser working on the text
+    bool indexed = !parallel && !mLazy && !mAllowComments && !mProjectionNode && mLength < UINT32_MAX;
+    if (indexed) {
+        // a window holds at most a token per byte, plus the tokens carried over
+        mTokens.resize(s_TokenWindowBlocks * 64 + 2);
+        mTokenCount = 0;
+        mNextToken = 0;
+        mIndexedLength = 0;
+        mPrevEscaped = 0;
+        mPrevInString = 0;
+        mPrevScalar = 0;
+        mStringBytes = 0;
+        indexTokens();
+        // the text parser skips long strings faster than stage 1 classifies them
+        indexed = mStringBytes <= s_MaxStringBytesPerToken * mTokenCount;
+    }
+    if (indexed) {
+        nextToken();
+        const char c = mText[mPosition];
+        if (c == '[') {
+            root = parseIndexedArray(1);
+        } else if (c == '{') {
+            root = parseIndexedObject(1);
+        } else {
+            throw ParseError(mText, mLength, mPosition, "Syntax error");
+        }
+        nextToken();
+    } else if (tryToConsume("[")) {
+        if (parallel) {
+            root = parseArrayParallel();
+        } else {
+            root = mLazy ? parseLazy<Array>(1) : parseArray(1);
+        }
     } else if (tryToConsume("{")) {
-        root.reset(parseObject(1));
+        root = mLazy ? parseLazy<Object>(1) : parseObject(1);
     } else {
         throw ParseError(mText, mLength, mPosition, "Syntax error");
     }
@@ -1606,100 +3328,3662 @@ JSON Parser::parse(const char* txt, size_t length) {
     if (mPosition != mLength) {
         throw ParseError(mText, mLength, mPosition, "Extra bytes at end of json");
     }
-    return JSON(std::move(root));
+    mArena = nullptr;
+    return JSON(std::move(arena), root);
 }
 
-JSON Parser::parse(const char* txt) {
-    return parse(txt, strlen(txt));
-}
+bool Parser::parse(const char* txt, size_t length, Handler& handler) {
+    mText = txt;
+    mLength = length;
+    mPosition = 0;
+    mArena = nullptr;
 
-JSON Parser::parse(const std::string& txt) {
-    return parse(txt.c_str());
-}
+    skipWhitespaces();
+    if (mPosition == mLength) {
+        throw ParseError(mText, mLength, mPosition, "Empty input");
+    }
 
-JSON Parser::parseString(const char* txt, bool allowComments) {
-    Parser parser;
-    parser.allowComments(allowComments);
-    return parser.parse(txt);
-}
+    bool completed = false;
+    if (tryToConsume("[")) {
+        completed = parseArrayEvents(handler, 1);
+    } else if (tryToConsume("{")) {
+        completed = parseObjectEvents(handler, 1);
+    } else {
+        throw ParseError(mText, mLength, mPosition, "Syntax error");
+    }
+    if (!completed) {
+        return false;
+    }
 
-JSON Parser::parseString(const char* txt, size_t length, bool allowComments) {
-    Parser parser;
-    parser.allowComments(allowComments);
-    return parser.parse(txt, length);
+    skipWhitespaces();
+    if (mPosition != mLength) {
+        throw ParseError(mText, mLength, mPosition, "Extra bytes at end of json");
+    }
+    return true;
 }
 
-JSON Parser::parseString(const std::string& txt, bool allowComments) {
-    Parser parser;
-    parser.allowComments(allowComments);
-    return parser.parse(txt);
+bool Parser::parse(const std::string& txt, Handler& handler) {
+    return parse(txt.c_str(), txt.length(), handler);
 }
 
-JSON Parser::parseFile(const std::string& path, bool allowComments) {
-    struct FileCloser {
-        FILE* mFile;
-        FileCloser(FILE* f) {
-            mFile = f;
-        }
-
-        ~FileCloser() {
-            fclose(mFile);
+// NOTE: mirrors parseValue(), parseArray() and parseObject() but reports events instead of building entities
+bool Parser::parseValueEvents(Handler& handler, size_t depth) {
+    switch (mPosition < mLength ? mText[mPosition] : '\0') {
+    case '"':
+        mPosition++;
+        if (tryToConsume("\"")) {
+            // special case: empty string
+            return handler.string(std::string_view());
         }
-    };
-
-    auto* f = fopen(path.c_str(), "rb");
-    if (!f) {
-        throw IOError("Failed to open file %s", path.c_str());
+        return handler.string(parseStringLiteral());
+    case '[':
+        mPosition++;
+        return parseArrayEvents(handler, depth + 1);
+    case '{':
+        mPosition++;
+        return parseObjectEvents(handler, depth + 1);
+    case 't':
+        consumeOrDie("true");
+        return handler.boolean(true);
+    case 'f':
+        consumeOrDie("false");
+        return handler.boolean(false);
+    case 'n':
+        consumeOrDie("null");
+        return handler.null();
+    default:
+        return handler.number(scanNumber());
     }
+}
 
-    FileCloser file(f); // close the file when leaving this method
-
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    if (size < 0) {
-        int err = errno;
-        throw IOError("Read error in file %s, errno: %d (%s)", path.c_str(), err, strerror(err));
+bool Parser::parseArrayEvents(Handler& handler, size_t depth) {
+    if (depth > mMaxDepth) {
+        throw TooManyNestings(mText, mLength, mPosition);
     }
-    fseek(f, 0, SEEK_SET);
-    char* buf = new char[size];
-    size_t rd = fread(buf, 1, size, f);
-
-    if (rd != (size_t)size) {
-        delete[] buf;
-        throw IOError("Failed to read %zu bytes from file (read=%zu)", size, (size_t)rd);
+    if (!handler.startArray()) {
+        return false;
     }
-    auto context = parseString(buf, size, allowComments);
-    delete[] buf;
-    return context;
-}
 
-Writer::Writer(bool prettyPrint, const std::string& indentation, int level)
-: mPrettyPrint(prettyPrint),
-  mIndentation(indentation),
-  mLevel(level)
+    size_t count = 0;
+    while (true) {
+        skipWhitespaces();
+
+        if (tryToConsume("//")) {
+            if (!handler.comment(scanComment())) {
+                return false;
+            }
+            count++;
+            skipWhitespaces();
+        }
+
+        // empty array?
+        if (count == 0
+            && tryToConsume("]")) {
+            break;
+        }
+
+        if (!parseValueEvents(handler, depth)) {
+            return false;
+        }
+        count++;
+
+        skipWhitespaces();
+
+        if (tryToConsume("//")) {
+            if (!handler.comment(scanComment())) {
+                return false;
+            }
+            skipWhitespaces();
+        }
+
+        if (!tryToConsume(",")) {
+            consumeOrDie("]");
+            break;
+        }
+    }
+    return handler.endArray();
+}
+
+bool Parser::parseObjectEvents(Handler& handler, size_t depth) {
+    if (depth > mMaxDepth) {
+        throw TooManyNestings(mText, mLength, mPosition);
+    }
+    if (!handler.startObject()) {
+        return false;
+    }
+
+    size_t count = 0;
+    while (true) {
+        skipWhitespaces();
+
+        // empty object?
+        if (count == 0
+            && tryToConsume("}")) {
+            break;
+        }
+
+        if (tryToConsume("//")) {
+            if (!handler.comment(scanComment())) {
+                return false;
+            }
+            skipWhitespaces();
+        }
+
+        if (!handler.key(parseKey())) {
+            return false;
+        }
+        skipWhitespaces();
+        consumeOrDie(":");
+        skipWhitespaces();
+        if (!parseValueEvents(handler, depth)) {
+            return false;
+        }
+        count++;
+
+        skipWhitespaces();
+
+        if (tryToConsume("//")) {
+            if (!handler.comment(scanComment())) {
+                return false;
+            }
+            skipWhitespaces();
+        }
+
+        if (!tryToConsume(",")) {
+            consumeOrDie("}");
+            break;
+        }
+    }
+    return handler.endObject();
+}
+
+JSON Parser::parse(const char* txt) {
+    return parse(txt, strlen(txt));
+}
+
+JSON Parser::parse(const std::string& txt) {
+    return parse(txt.c_str(), txt.length());
+}
+
+JSON Parser::parse(std::string&& txt) {
+    if (!mZeroCopy && !mLazy) {
+        return parse(txt.c_str(), txt.length());
+    }
+
+    auto arena = std::make_unique<Arena>();
+    const auto* input = arena->own(new std::string(std::move(txt)));
+    mText = input->c_str();
+    mLength = input->length();
+    return parseDocument(std::move(arena));
+}
+
+JSON Parser::parseString(const char* txt, bool allowComments) {
+    Parser parser;
+    parser.allowComments(allowComments);
+    return parser.parse(txt);
+}
+
+JSON Parser::parseString(const char* txt, size_t length, bool allowComments) {
+    Parser parser;
+    parser.allowComments(allowComments);
+    return parser.parse(txt, length);
+}
+
+JSON Parser::parseString(const std::string& txt, bool allowComments) {
+    Parser parser;
+    parser.allowComments(allowComments);
+    return parser.parse(txt);
+}
+
+// Read only content of a whole file. Memory mapped where supported, read into
+// a heap buffer otherwise.
+class MappedFile {
+public:
+    // how the content is read, a hint for the kernel
+    enum class Access {
+        // once from start to end
+        sequential,
+        // again after parsing, in any order
+        normal,
+    };
+
+    explicit MappedFile(const std::string& path, Access access = Access::sequential);
+    ~MappedFile();
+
+    const char* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    void operator=(const MappedFile&) = delete;
+
+    const char* mData = "";
+    size_t mSize = 0;
+    bool mMapped = false;
+    std::unique_ptr<char[]> mBuffer;
+};
+
+#ifndef _WIN32
+
+MappedFile::MappedFile(const std::string& path, Access access) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw IOError("Failed to open file %s", path.c_str());
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int err = errno;
+        close(fd);
+        throw IOError("Read error in file %s, errno: %d (%s)", path.c_str(), err, strerror(err));
+    }
+
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (size > SIZE_MAX) {
+        close(fd);
+        throw IOError("File %s is too large to be mapped", path.c_str());
+    }
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+
+    void* mapped = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+    const int err = errno;
+    close(fd); // the mapping stays valid
+    if (mapped == MAP_FAILED) {
+        throw IOError("Failed to map file %s, errno: %d (%s)", path.c_str(), err, strerror(err));
+    }
+    madvise(mapped, static_cast<size_t>(size), access == Access::sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+
+    mData = static_cast<const char*>(mapped);
+    mSize = static_cast<size_t>(size);
+    mMapped = true;
+}
+
+MappedFile::~MappedFile() {
+    if (mMapped) {
+        munmap(const_cast<char*>(mData), mSize);
+    }
+}
+
+#else // !_WIN32
+
+MappedFile::MappedFile(const std::string& path, Access) {
+    struct FileCloser {
+        FILE* mFile;
+        FileCloser(FILE* f) {
+            mFile = f;
+        }
+
+        ~FileCloser() {
+            fclose(mFile);
+        }
+    };
+
+    FILE* f = nullptr;
+    if (fopen_s(&f, path.c_str(), "rb") != 0 || !f) {
+        throw IOError("Failed to open file %s", path.c_str());
+    }
+
+    FileCloser file(f); // close the file when leaving this method
+
+    _fseeki64(f, 0, SEEK_END);
+    const __int64 size = _ftelli64(f);
+    if (size < 0) {
+        int err = errno;
+        throw IOError("Read error in file %s, errno: %d (%s)", path.c_str(), err, strerror(err));
+    }
+    if (static_cast<uint64_t>(size) > SIZE_MAX) {
+        throw IOError("File %s is too large to be read", path.c_str());
+    }
+    _fseeki64(f, 0, SEEK_SET);
+
+    mBuffer.reset(new char[static_cast<size_t>(size)]);
+    const size_t rd = fread(mBuffer.get(), 1, static_cast<size_t>(size), f);
+    if (rd != static_cast<size_t>(size)) {
+        throw IOError("Failed to read %zu bytes from file (read=%zu)", static_cast<size_t>(size), rd);
+    }
+    mData = mBuffer.get();
+    mSize = rd;
+}
+
+MappedFile::~MappedFile() {
+}
+
+#endif // !_WIN32
+
+JSON Parser::parseFile(const std::string& path, bool allowComments) {
+    Parser parser;
+    parser.allowComments(allowComments);
+    return parser.load(path);
+}
+
+JSON Parser::load(const std::string& path) {
+    auto arena = std::make_unique<Arena>();
+    if (mZeroCopy || mLazy) {
+        // the document references the mapping, the arena keeps it alive
+        const auto* file = arena->own(new MappedFile(path, MappedFile::Access::normal));
+        mText = file->data();
+        mLength = file->size();
+        return parseDocument(std::move(arena));
+    }
+
+    const MappedFile file(path);
+    mText = file.data();
+    mLength = file.size();
+    return parseDocument(std::move(arena));
+}
+
+DocumentBuilder::DocumentBuilder() {
+    reset();
+}
+
+DocumentBuilder::~DocumentBuilder() {
+}
+
+void DocumentBuilder::reset() {
+    mArena = std::make_unique<Arena>();
+    mRoot = nullptr;
+    mContainers.clear();
+    mValueStack.clear();
+    mMemberStack.clear();
+    mKey = StringData();
+}
+
+void DocumentBuilder::addValue(Entity* entity) {
+    if (mContainers.empty()) {
+        if (mRoot) {
+            throw Exception("Document already has a root");
+        }
+        mRoot = entity;
+        return;
+    }
+
+    if (mContainers.back().mEntity->type() == Entity::Type::object) {
+        mMemberStack.push_back(Object::KeyAndEntity(mKey, entity));
+        mKey = StringData();
+    } else {
+        mValueStack.push_back(entity);
+    }
+}
+
+bool DocumentBuilder::startObject() {
+    auto* obj = Entity::create<Object>(mArena.get());
+    addValue(obj);
+    mContainers.push_back(Container{obj, mMemberStack.size()});
+    return true;
+}
+
+bool DocumentBuilder::key(std::string_view key) {
+    const auto pooled = mArena->stringPool().intern(key);
+    mKey.reference(pooled.data(), pooled.length());
+    return true;
+}
+
+bool DocumentBuilder::endObject() {
+    if (mContainers.empty() || mContainers.back().mEntity->type() != Entity::Type::object) {
+        throw Exception("endObject() without matching startObject()");
+    }
+    const size_t stackStart = mContainers.back().mStackStart;
+    static_cast<Object*>(mContainers.back().mEntity)->setMembers(mMemberStack.data() + stackStart, mMemberStack.data() + mMemberStack.size());
+    mMemberStack.resize(stackStart);
+    mContainers.pop_back();
+    return true;
+}
+
+bool DocumentBuilder::startArray() {
+    auto* arr = Entity::create<Array>(mArena.get());
+    addValue(arr);
+    mContainers.push_back(Container{arr, mValueStack.size()});
+    return true;
+}
+
+bool DocumentBuilder::endArray() {
+    if (mContainers.empty() || mContainers.back().mEntity->type() != Entity::Type::array) {
+        throw Exception("endArray() without matching startArray()");
+    }
+    const size_t stackStart = mContainers.back().mStackStart;
+    static_cast<Array*>(mContainers.back().mEntity)->mValues.assign(mValueStack.begin() + stackStart, mValueStack.end());
+    mValueStack.resize(stackStart);
+    mContainers.pop_back();
+    return true;
+}
+
+bool DocumentBuilder::string(std::string_view value) {
+    auto* str = Entity::create<String>(mArena.get());
+    if (value.length() <= Parser::s_MaxInternedValueLength) {
+        const auto pooled = mArena->stringPool().intern(value);
+        str->mValue.reference(pooled.data(), pooled.length());
+    } else {
+        str->mValue.assign(mArena.get(), value.data(), value.length());
+    }
+    addValue(str);
+    return true;
+}
+
+bool DocumentBuilder::number(std::string_view number) {
+    auto* num = Entity::create<Number>(mArena.get());
+    num->setParsed(number);
+    addValue(num);
+    return true;
+}
+
+bool DocumentBuilder::boolean(bool value) {
+    auto* b = Entity::create<Boolean>(mArena.get());
+    b->setBool(value);
+    addValue(b);
+    return true;
+}
+
+bool DocumentBuilder::null() {
+    addValue(Entity::create<Null>(mArena.get()));
+    return true;
+}
+
+bool DocumentBuilder::comment(std::string_view text) {
+    auto* comment = Entity::create<Comment>(mArena.get());
+    comment->mText.assign(mArena.get(), text.data(), text.length());
+    addValue(comment);
+    return true;
+}
+
+JSON DocumentBuilder::document() {
+    if (!isComplete()) {
+        throw Exception("Document is incomplete");
+    }
+    JSON json(std::move(mArena), mRoot);
+    reset();
+    return json;
+}
+
+static bool isNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// same grammar as Parser::scanNumber()
+static bool isValidNumber(std::string_view number) {
+    size_t i = 0;
+    const size_t n = number.length();
+    auto digits = [&]() {
+        while (i < n && number[i] >= '0' && number[i] <= '9') {
+            i++;
+        }
+    };
+
+    if (i < n && number[i] == '-') {
+        i++;
+    }
+    if (i < n && number[i] == '0') {
+        i++;
+    } else if (i < n && number[i] >= '1' && number[i] <= '9') {
+        digits();
+    } else {
+        return false;
+    }
+    if (i < n && number[i] == '.') {
+        i++;
+        digits();
+    }
+    if (i < n && (number[i] == 'e' || number[i] == 'E')) {
+        i++;
+        if (i == n || (number[i] != '+' && number[i] != '-')) {
+            return false;
+        }
+        i++;
+        digits();
+    }
+    return i == n;
+}
+
+PushParser::PushParser(Handler& handler)
+: mHandler(handler)
 {
 }
 
-void Writer::write(const std::string& path, const Entity& ent) {
-    std::string json = ent.toString(mPrettyPrint, mIndentation, mLevel);
+void PushParser::allowComments(bool allow) {
+    mAllowComments = allow;
+}
+
+void PushParser::setMaxDepth(size_t maxDepth) {
+    mMaxDepth = maxDepth;
+}
+
+bool PushParser::feed(const char* data, size_t length) {
+    mChunk = data;
+    const char* pos = data;
+    const char* end = data + length;
+    while (pos < end && mState != State::stopped) {
+        switch (mToken) {
+        case Token::string:
+            pos = continueString(pos, end);
+            break;
+        case Token::number:
+            pos = continueNumber(pos, end);
+            break;
+        case Token::literal:
+            pos = continueLiteral(pos, end);
+            break;
+        case Token::comment:
+            pos = continueComment(pos, end);
+            break;
+        case Token::none: {
+                const char c = *pos;
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    pos++;
+                } else {
+                    pos = handleChar(pos);
+                }
+            }
+            break;
+        }
+    }
+    mOffset += length;
+    return mState != State::stopped;
+}
+
+void PushParser::finish() {
+    if (mState == State::stopped) {
+        return;
+    }
+    if (mState == State::start) {
+        throw ParseError(nullptr, 0, mOffset, "Empty input");
+    }
+    if (mState != State::done) {
+        throw ParseError(nullptr, 0, mOffset, "Unexpected end of json");
+    }
+}
+
+// handles the first character of a token, returns the position after it
+const char* PushParser::handleChar(const char* pos) {
+    const char c = *pos;
+
+    // comments are accepted where Parser accepts them: before keys, around array values and after values
+    const bool commentAllowed = mState == State::objectKeyOrEnd || mState == State::objectKey || mState == State::commaOrEnd
+        || mState == State::arrayValueOrEnd || (mState == State::value && mContainers.back() == '[');
+    if (c == '/' && commentAllowed) {
+        if (!mAllowComments) {
+            throw ParseError(nullptr, 0, offset(pos), "Comments are disabled");
+        }
+        mToken = Token::comment;
+        mCommentStarted = false;
+        mTokenText.clear();
+        return pos + 1;
+    }
+
+    switch (mState) {
+    case State::start:
+        if (c != '{' && c != '[') {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error");
+        }
+        openContainer(c);
+        return pos + 1;
+
+    case State::done:
+        throw ParseError(nullptr, 0, offset(pos), "Extra bytes at end of json");
+
+    case State::objectKeyOrEnd:
+    case State::objectKey:
+        if (c == '}' && mState == State::objectKeyOrEnd) {
+            closeContainer(c);
+        } else if (c == '"') {
+            mToken = Token::string;
+            mStringIsKey = true;
+            mTokenText.clear();
+        } else {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Expected '\"' at position %zu", offset(pos));
+        }
+        return pos + 1;
+
+    case State::colon:
+        if (c != ':') {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Expected ':' at position %zu", offset(pos));
+        }
+        mState = State::value;
+        return pos + 1;
+
+    case State::commaOrEnd:
+        if (c == ',') {
+            mState = mContainers.back() == '{' ? State::objectKey : State::value;
+        } else if ((c == '}' && mContainers.back() == '{') || (c == ']' && mContainers.back() == '[')) {
+            closeContainer(c);
+        } else {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Expected ',' or '%c' at position %zu", mContainers.back() == '{' ? '}' : ']', offset(pos));
+        }
+        return pos + 1;
+
+    case State::value:
+    case State::arrayValueOrEnd:
+        if (c == ']' && mState == State::arrayValueOrEnd) {
+            closeContainer(c);
+        } else if (c == '{' || c == '[') {
+            openContainer(c);
+        } else if (c == '"') {
+            mToken = Token::string;
+            mStringIsKey = false;
+            mTokenText.clear();
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            mToken = Token::literal;
+            mLiteral = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+            mLiteralIndex = 1;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            mToken = Token::number;
+            mTokenText.clear();
+            return pos; // the number token includes this character
+        } else {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Unexpected '%c' at position %zu", c, offset(pos));
+        }
+        return pos + 1;
+
+    case State::stopped:
+        break;
+    }
+    return pos + 1;
+}
+
+void PushParser::openContainer(char c) {
+    if (mContainers.size() + 1 > mMaxDepth) {
+        throw TooManyNestings(nullptr, 0, mOffset);
+    }
+    mContainers.push_back(c);
+    if (c == '{') {
+        mState = mHandler.startObject() ? State::objectKeyOrEnd : State::stopped;
+    } else {
+        mState = mHandler.startArray() ? State::arrayValueOrEnd : State::stopped;
+    }
+}
+
+void PushParser::closeContainer(char c) {
+    mContainers.pop_back();
+    valueDone(c == '}' ? mHandler.endObject() : mHandler.endArray());
+}
+
+void PushParser::valueDone(bool ok) {
+    mToken = Token::none;
+    if (!ok) {
+        mState = State::stopped;
+    } else if (mContainers.empty()) {
+        mState = State::done;
+    } else {
+        mState = State::commaOrEnd;
+    }
+}
+
+const char* PushParser::continueString(const char* pos, const char* end) {
+    while (pos < end) {
+        if (mEscape == 0) {
+            const char* next = findQuoteOrBackslash(pos, end);
+            if (next == end) {
+                mTokenText.append(pos, end);
+                return end;
+            }
+
+            if (*next == '\\') {
+                mTokenText.append(pos, next);
+                mEscape = 1;
+                pos = next + 1;
+                continue;
+            }
+
+            // closing quote, strings within a single chunk are passed without copying
+            std::string_view str(pos, next - pos);
+            if (!mTokenText.empty()) {
+                mTokenText.append(pos, next);
+                str = mTokenText;
+            }
+            if (mStringIsKey) {
+                mToken = Token::none;
+                mState = mHandler.key(str) ? State::colon : State::stopped;
+            } else {
+                valueDone(mHandler.string(str));
+            }
+            return next + 1;
+        }
+
+        const char c = *pos++;
+        if (mEscape == 1) {
+            if (c == 'u') {
+                mEscape = 2;
+                mUnicodeDigits = 0;
+                mUnicodeValue = 0;
+            } else {
+                mTokenText += unescapeChar(c);
+                mEscape = 0;
+            }
+            continue;
+        }
+
+        const int value = hexDigitValue(c);
+        if (value < 0) {
+            throw ParseError(nullptr, 0, offset(pos - 1), "Invalid \\u escaping");
+        }
+        mUnicodeValue = (mUnicodeValue << 4) | value;
+        if (++mUnicodeDigits == 4) {
+            char utf8Buf[4];
+            mTokenText.append(utf8Buf, writeUTF8Chars(utf8Buf, mUnicodeValue));
+            mEscape = 0;
+        }
+    }
+    return pos;
+}
+
+const char* PushParser::continueNumber(const char* pos, const char* end) {
+    const char* start = pos;
+    while (pos < end && isNumberChar(*pos)) {
+        pos++;
+    }
+    if (pos == end) {
+        // the number may continue in the next chunk
+        mTokenText.append(start, end);
+        return end;
+    }
+
+    std::string_view number(start, pos - start);
+    if (!mTokenText.empty()) {
+        mTokenText.append(start, pos);
+        number = mTokenText;
+    }
+    if (!isValidNumber(number)) {
+        throw ParseError(nullptr, 0, offset(pos), "Invalid number");
+    }
+    valueDone(mHandler.number(number));
+    return pos;
+}
+
+const char* PushParser::continueLiteral(const char* pos, const char* end) {
+    while (pos < end && mLiteral[mLiteralIndex] != 0) {
+        if (*pos != mLiteral[mLiteralIndex]) {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Expected '%s'", mLiteral);
+        }
+        pos++;
+        mLiteralIndex++;
+    }
+    if (mLiteral[mLiteralIndex] == 0) {
+        if (mLiteral[0] == 'n') {
+            valueDone(mHandler.null());
+        } else {
+            valueDone(mHandler.boolean(mLiteral[0] == 't'));
+        }
+    }
+    return pos;
+}
+
+const char* PushParser::continueComment(const char* pos, const char* end) {
+    if (!mCommentStarted) {
+        if (*pos != '/') {
+            throw ParseError(nullptr, 0, offset(pos), "Syntax error: Expected '//'");
+        }
+        mCommentStarted = true;
+        pos++;
+    }
+
+    const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (!newline) {
+        mTokenText.append(pos, end);
+        return end;
+    }
+
+    std::string_view text(pos, newline - pos);
+    if (!mTokenText.empty()) {
+        mTokenText.append(pos, newline);
+        text = mTokenText;
+    }
+    mToken = Token::none;
+    if (!mHandler.comment(text)) {
+        mState = State::stopped;
+    }
+    return newline + 1;
+}
+
+static const uint64_t TapePayloadMask = (uint64_t(1) << 56) - 1;
+static const uint64_t TapeIndexMask = 0xFFFFFFFF;
+static const uint64_t TapeMaxCount = 0xFFFFFF; // larger counts are found by walking the container
+static const uint64_t TapeKeyTableMinCount = 16; // smaller objects are scanned
+
+// Handler writing the events of a parse to a tape
+class TapeBuilder : public Handler {
+public:
+    explicit TapeBuilder(Tape& tape) : mTape(tape) {
+    }
+
+    bool startObject() override {
+        return open('{');
+    }
+
+    bool key(std::string_view key) override {
+        addString(key);
+        return true;
+    }
+
+    bool endObject() override {
+        return close('}');
+    }
+
+    bool startArray() override {
+        return open('[');
+    }
+
+    bool endArray() override {
+        return close(']');
+    }
+
+    bool string(std::string_view value) override {
+        countValue();
+        addString(value);
+        return true;
+    }
+
+    bool number(std::string_view number) override {
+        countValue();
+        int64_t i = 0;
+        double d = 0.0;
+        if (parseNumberText(number, i, d)) {
+            add('l', 0);
+            mTape.mWords.push_back(static_cast<uint64_t>(i));
+        } else {
+            add('d', 0);
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            mTape.mWords.push_back(bits);
+        }
+        return true;
+    }
+
+    bool boolean(bool value) override {
+        countValue();
+        add(value ? 't' : 'f', 0);
+        return true;
+    }
+
+    bool null() override {
+        countValue();
+        add('n', 0);
+        return true;
+    }
+
+private:
+    struct Container {
+        size_t mIndex;
+        uint64_t mCount;
+    };
+
+    void add(char tag, uint64_t payload) {
+        mTape.mWords.push_back((static_cast<uint64_t>(static_cast<uint8_t>(tag)) << 56) | payload);
+    }
+
+    void countValue() {
+        if (!mContainers.empty()) {
+            mContainers.back().mCount++;
+        }
+    }
+
+    void addString(std::string_view str) {
+        if (str.length() > UINT32_MAX || mTape.mStrings.size() > TapePayloadMask) {
+            throw Exception("Document is too large for a tape");
+        }
+        add('"', mTape.mStrings.size());
+        const uint32_t length = static_cast<uint32_t>(str.length());
+        const char* bytes = reinterpret_cast<const char*>(&length);
+        mTape.mStrings.insert(mTape.mStrings.end(), bytes, bytes + sizeof(length));
+        mTape.mStrings.insert(mTape.mStrings.end(), str.data(), str.data() + str.length());
+    }
+
+    bool open(char tag) {
+        countValue();
+        mContainers.push_back(Container{mTape.mWords.size(), 0});
+        add(tag, 0); // completed by close()
+        return true;
+    }
+
+    bool close(char tag) {
+        const auto container = mContainers.back();
+        mContainers.pop_back();
+        const size_t index = mTape.mWords.size();
+        if (index > TapeIndexMask) {
+            throw Exception("Document is too large for a tape");
+        }
+        mTape.mWords[container.mIndex] |= (std::min(container.mCount, TapeMaxCount) << 32) | index;
+        add(tag, container.mIndex);
+        return true;
+    }
+
+public:
+    // appends the key tables: their count, one word per table with the index of its
+    // object and its offset, then the tables. A table is its capacity followed by
+    // 32 bit slots with the index of a key word, 0 for empty slots.
+    void addKeyTables() {
+        auto& words = mTape.mWords;
+        const size_t end = words.size();
+        std::vector<size_t> objects;
+        for (size_t i = 0; i < end; i++) {
+            const uint64_t word = words[i];
+            const char tag = static_cast<char>(word >> 56);
+            if (tag == '{' && ((word >> 32) & TapeMaxCount) > TapeKeyTableMinCount) {
+                objects.push_back(i);
+            } else if (tag == 'l' || tag == 'd') {
+                i++; // value word
+            }
+        }
+
+        words.push_back(objects.size());
+        const size_t directory = words.size();
+        words.resize(directory + objects.size());
+        for (size_t o = 0; o < objects.size(); o++) {
+            const TapeValue object(words.data(), mTape.mStrings.data(), objects[o]);
+            size_t capacity = 1;
+            while (capacity < object.count() * 2) {
+                capacity *= 2;
+            }
+            const size_t offset = words.size();
+            if (offset + 1 + capacity / 2 > TapeIndexMask) {
+                throw Exception("Document is too large for a tape");
+            }
+            words[directory + o] = (static_cast<uint64_t>(objects[o]) << 32) | offset;
+            words.push_back(capacity);
+            words.resize(offset + 1 + (capacity + 1) / 2);
+
+            // the last of equal keys wins, like in Object
+            auto* slots = reinterpret_cast<uint32_t*>(words.data() + offset + 1);
+            for (const auto& member : TapeValue(words.data(), mTape.mStrings.data(), objects[o]).object()) {
+                const uint32_t keyIndex = static_cast<uint32_t>(member.value().mIndex - 1);
+                size_t slot = hashString(member.key()) & (capacity - 1);
+                while (slots[slot] != 0 && TapeValue(words.data(), mTape.mStrings.data(), slots[slot]).stringView() != member.key()) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                slots[slot] = keyIndex;
+            }
+        }
+    }
+
+private:
+    Tape& mTape;
+    std::vector<Container> mContainers;
+};
+
+Tape Tape::parse(const char* txt, size_t length, bool allowComments) {
+    Tape tape;
+    tape.mWords.reserve(length / 8 + 2);
+    TapeBuilder builder(tape);
+    Parser parser;
+    parser.allowComments(allowComments);
+    parser.parse(txt, length, builder);
+    builder.addKeyTables();
+    return tape;
+}
+
+Tape Tape::parse(const std::string& txt, bool allowComments) {
+    return parse(txt.data(), txt.length(), allowComments);
+}
+
+Tape Tape::load(const std::string& path, bool allowComments) {
+    const MappedFile file(path);
+    return parse(file.data(), file.size(), allowComments);
+}
+
+// the words follow the 64 byte header and are aligned like the mapping
+struct TapeSnapshotHeader {
+    char mMagic[8];
+    uint32_t mVersion;
+    uint32_t mByteOrder;
+    uint64_t mWordCount;
+    uint64_t mStringLength;
+    char mReserved[32];
+};
+
+static const char TapeSnapshotMagic[8] = {'C', 'S', 'O', 'N', 'T', 'A', 'P', 'E'};
+static const uint32_t TapeSnapshotVersion = 1;
+static const uint32_t TapeSnapshotByteOrder = 0x01020304;
+
+void Tape::write(Sink& sink) const {
+    TapeSnapshotHeader header = {};
+    memcpy(header.mMagic, TapeSnapshotMagic, sizeof(header.mMagic));
+    header.mVersion = TapeSnapshotVersion;
+    header.mByteOrder = TapeSnapshotByteOrder;
+    header.mWordCount = words();
+    header.mStringLength = mMapping ? mMappedStringLength : mStrings.size();
+    sink.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    sink.write(reinterpret_cast<const char*>(wordData()), header.mWordCount * sizeof(uint64_t));
+    sink.write(stringData(), header.mStringLength);
+}
+
+void Tape::save(const std::string& path) const {
+    auto* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        throw IOError("Failed to open file for writing");
+    }
+
+    try {
+        FileSink sink(f);
+        write(sink);
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
+
+    if (fclose(f) != 0) {
+        throw IOError("Failed to write all bytes to file");
+    }
+}
+
+// checks that the indices and offsets of a mapped snapshot stay within it and its
+// containers nest, so the accessors can trust its words like those of a parsed tape
+static bool isValidTape(const uint64_t* words, size_t wordCount, const char* strings, size_t stringLength) {
+    const char rootTag = static_cast<char>(words[0] >> 56);
+    if (rootTag != '{' && rootTag != '[') {
+        return false;
+    }
+    // the root ends with the last value word, the count of key tables follows
+    const size_t valueEnd = (words[0] & TapeIndexMask) + 1;
+    if (valueEnd >= wordCount) {
+        return false;
+    }
+
+    struct Open {
+        size_t mIndex;
+        size_t mEnd;
+        uint64_t mChildren;
+    };
+    std::vector<Open> open;
+    // words starting a value or key, as opposed to the second word of numbers
+    std::vector<bool> starts(valueEnd);
+    for (size_t i = 0; i < valueEnd; i++) {
+        const uint64_t word = words[i];
+        const char tag = static_cast<char>(word >> 56);
+        if (!open.empty() && i == open.back().mEnd) {
+            const Open container = open.back();
+            open.pop_back();
+            const bool object = static_cast<char>(words[container.mIndex] >> 56) == '{';
+            if (tag != (object ? '}' : ']') || (word & TapePayloadMask) != container.mIndex) {
+                return false;
+            }
+            // the members of objects are a key and a value
+            const uint64_t count = object ? container.mChildren / 2 : container.mChildren;
+            if ((object && container.mChildren % 2 != 0) || ((words[container.mIndex] >> 32) & TapeMaxCount) != std::min(count, TapeMaxCount)) {
+                return false;
+            }
+            continue;
+        }
+
+        starts[i] = true;
+        if (!open.empty()) {
+            auto& parent = open.back();
+            if (static_cast<char>(words[parent.mIndex] >> 56) == '{' && parent.mChildren % 2 == 0 && tag != '"') {
+                return false;
+            }
+            parent.mChildren++;
+        } else if (i != 0) {
+            return false;
+        }
+        const size_t limit = open.empty() ? valueEnd : open.back().mEnd;
+        switch (tag) {
+        case '{':
+        case '[': {
+            const size_t end = word & TapeIndexMask;
+            if (end <= i || end >= limit) {
+                return false;
+            }
+            open.push_back(Open{i, end, 0});
+            break;
+        }
+        case 'l':
+        case 'd':
+            if (i + 1 >= limit) {
+                return false;
+            }
+            i++; // value word
+            break;
+        case '"': {
+            const uint64_t offset = word & TapePayloadMask;
+            if (offset > stringLength || stringLength - offset < sizeof(uint32_t)) {
+                return false;
+            }
+            uint32_t length;
+            memcpy(&length, strings + offset, sizeof(length));
+            if (stringLength - offset - sizeof(uint32_t) < length) {
+                return false;
+            }
+            break;
+        }
+        case 't':
+        case 'f':
+        case 'n':
+            break;
+        default:
+            return false;
+        }
+    }
+    if (!open.empty()) {
+        return false;
+    }
+
+    // key tables, sorted by the index of their object
+    const uint64_t tables = words[valueEnd];
+    if (tables > wordCount - valueEnd - 1) {
+        return false;
+    }
+    for (size_t t = 0; t < tables; t++) {
+        const uint64_t entry = words[valueEnd + 1 + t];
+        const size_t object = static_cast<size_t>(entry >> 32);
+        const size_t offset = static_cast<size_t>(entry & TapeIndexMask);
+        if (object >= valueEnd || !starts[object] || static_cast<char>(words[object] >> 56) != '{'
+            || (t != 0 && object <= (words[valueEnd + t] >> 32)) || offset >= wordCount) {
+            return false;
+        }
+        const uint64_t capacity = words[offset];
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0 || (capacity + 1) / 2 > wordCount - offset - 1) {
+            return false;
+        }
+        // lookups stop at the first empty slot
+        const auto* slots = reinterpret_cast<const uint32_t*>(words + offset + 1);
+        bool empty = false;
+        for (size_t slot = 0; slot < capacity; slot++) {
+            if (slots[slot] == 0) {
+                empty = true;
+            } else if (slots[slot] >= valueEnd || !starts[slots[slot]] || static_cast<char>(words[slots[slot]] >> 56) != '"') {
+                return false;
+            }
+        }
+        if (!empty) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Tape Tape::map(const std::string& path) {
+    // validated front to back, then queried through key tables
+    auto file = std::make_shared<MappedFile>(path, MappedFile::Access::normal);
+    TapeSnapshotHeader header;
+    if (file->size() < sizeof(header)) {
+        throw IOError("File %s is not a tape snapshot", path.c_str());
+    }
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.mMagic, TapeSnapshotMagic, sizeof(header.mMagic)) != 0 || header.mVersion != TapeSnapshotVersion) {
+        throw IOError("File %s is not a tape snapshot", path.c_str());
+    }
+    if (header.mByteOrder != TapeSnapshotByteOrder) {
+        throw IOError("Tape snapshot %s was written with a different byte order", path.c_str());
+    }
+    const uint64_t available = (file->size() - sizeof(header)) / sizeof(uint64_t);
+    if (header.mWordCount == 0 || header.mWordCount > available
+        || header.mStringLength != file->size() - sizeof(header) - header.mWordCount * sizeof(uint64_t)) {
+        throw IOError("Tape snapshot %s is truncated", path.c_str());
+    }
+
+    Tape tape;
+    tape.mMappedWords = reinterpret_cast<const uint64_t*>(file->data() + sizeof(header));
+    tape.mMappedWordCount = static_cast<size_t>(header.mWordCount);
+    tape.mMappedStrings = file->data() + sizeof(header) + tape.mMappedWordCount * sizeof(uint64_t);
+    tape.mMappedStringLength = static_cast<size_t>(header.mStringLength);
+    if (!isValidTape(tape.mMappedWords, tape.mMappedWordCount, tape.mMappedStrings, tape.mMappedStringLength)) {
+        throw IOError("Tape snapshot %s is corrupt", path.c_str());
+    }
+    tape.mMapping = std::move(file);
+    return tape;
+}
+
+Entity::Type TapeValue::type() const {
+    switch (tag()) {
+    case '{': return Entity::Type::object;
+    case '[': return Entity::Type::array;
+    case '"': return Entity::Type::string;
+    case 'l':
+    case 'd': return Entity::Type::number;
+    case 't':
+    case 'f': return Entity::Type::boolean;
+    default: return Entity::Type::null;
+    }
+}
+
+size_t TapeValue::next() const {
+    switch (tag()) {
+    case '{':
+    case '[':
+        return (mWords[mIndex] & TapeIndexMask) + 1;
+    case 'l':
+    case 'd':
+        return mIndex + 2;
+    default:
+        return mIndex + 1;
+    }
+}
+
+TapeObject TapeValue::object() const {
+    if (!isObject()) {
+        throw InvalidType();
+    }
+    return TapeObject(*this);
+}
+
+TapeArray TapeValue::array() const {
+    if (!isArray()) {
+        throw InvalidType();
+    }
+    return TapeArray(*this);
+}
+
+size_t TapeValue::count() const {
+    if (!isObject() && !isArray()) {
+        throw Exception("Count is not applicable for this type");
+    }
+    const uint64_t count = (mWords[mIndex] >> 32) & TapeMaxCount;
+    if (count < TapeMaxCount) {
+        return count;
+    }
+
+    size_t counted = 0;
+    const size_t end = mWords[mIndex] & TapeIndexMask;
+    for (TapeValue value(mWords, mStrings, mIndex + 1); value.mIndex != end; value.mIndex = value.next()) {
+        if (isObject()) {
+            value.mIndex++; // key
+        }
+        counted++;
+    }
+    return counted;
+}
+
+std::string_view TapeValue::stringView() const {
+    if (!isString()) {
+        throw InvalidType();
+    }
+    const char* str = mStrings + (mWords[mIndex] & TapePayloadMask);
+    uint32_t length;
+    memcpy(&length, str, sizeof(length));
+    return std::string_view(str + sizeof(length), length);
+}
+
+int64_t TapeValue::int64Value() const {
+    if (tag() == 'l') {
+        return static_cast<int64_t>(mWords[mIndex + 1]);
+    }
+    return clampToInt64(doubleValue());
+}
+
+int TapeValue::intValue() const {
+    return clampToInt(int64Value());
+}
+
+double TapeValue::doubleValue() const {
+    if (tag() == 'l') {
+        return static_cast<double>(static_cast<int64_t>(mWords[mIndex + 1]));
+    }
+    if (tag() != 'd') {
+        throw InvalidType();
+    }
+    double d;
+    memcpy(&d, &mWords[mIndex + 1], sizeof(d));
+    return d;
+}
+
+bool TapeValue::boolValue() const {
+    if (!isBoolean()) {
+        throw InvalidType();
+    }
+    return tag() == 't';
+}
+
+TapeValue TapeValue::operator[] (size_t idx) const {
+    return array()[idx];
+}
+
+TapeValue TapeValue::operator[] (std::string_view key) const {
+    return object()[key];
+}
+
+TapeObject::Iterator::Iterator(const TapeValue& object, size_t keyIndex)
+: mMember{std::string_view(), TapeValue(object.mWords, object.mStrings, keyIndex + 1)},
+  mKeyIndex(keyIndex),
+  mEnd(object.mWords[object.mIndex] & TapeIndexMask)
+{
+    if (mKeyIndex != mEnd) {
+        mMember.mKey = TapeValue(object.mWords, object.mStrings, mKeyIndex).stringView();
+    }
+}
+
+TapeObject::Iterator& TapeObject::Iterator::operator++() {
+    mKeyIndex = mMember.mValue.next();
+    mMember.mValue.mIndex = mKeyIndex + 1;
+    if (mKeyIndex != mEnd) {
+        mMember.mKey = TapeValue(mMember.mValue.mWords, mMember.mValue.mStrings, mKeyIndex).stringView();
+    }
+    return *this;
+}
+
+TapeObject::Iterator TapeObject::begin() const {
+    return Iterator(mObject, mObject.mIndex + 1);
+}
+
+TapeObject::Iterator TapeObject::end() const {
+    return Iterator(mObject, mObject.mWords[mObject.mIndex] & TapeIndexMask);
+}
+
+bool TapeObject::contains(std::string_view key) const {
+    return valueForKey(key).has_value();
+}
+
+// the key table of a large object, nullptr for small objects
+static const uint32_t* findKeyTable(const uint64_t* words, size_t object, size_t& capacity) {
+    if (((words[object] >> 32) & TapeMaxCount) <= TapeKeyTableMinCount) {
+        return nullptr;
+    }
+    const size_t directory = (words[0] & TapeIndexMask) + 2;
+    const uint64_t* begin = words + directory;
+    const uint64_t* end = begin + words[directory - 1];
+    const uint64_t* entry = std::lower_bound(begin, end, static_cast<uint64_t>(object) << 32);
+    if (entry == end || (*entry >> 32) != object) {
+        return nullptr;
+    }
+    const size_t offset = *entry & TapeIndexMask;
+    capacity = static_cast<size_t>(words[offset]);
+    return reinterpret_cast<const uint32_t*>(words + offset + 1);
+}
+
+std::optional<TapeValue> TapeObject::valueForKey(std::string_view key) const {
+    size_t capacity = 0;
+    if (const auto* slots = findKeyTable(mObject.mWords, mObject.mIndex, capacity)) {
+        for (size_t slot = hashString(key) & (capacity - 1); slots[slot] != 0; slot = (slot + 1) & (capacity - 1)) {
+            const TapeValue candidate(mObject.mWords, mObject.mStrings, slots[slot]);
+            if (candidate.stringView() == key) {
+                return TapeValue(mObject.mWords, mObject.mStrings, slots[slot] + 1);
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<TapeValue> found;
+    for (const auto& member : *this) {
+        if (member.key() == key) {
+            found = member.value();
+        }
+    }
+    return found;
+}
+
+TapeValue TapeObject::operator[] (std::string_view key) const {
+    const auto value = valueForKey(key);
+    if (!value) {
+        throw NoSuchKey();
+    }
+    return *value;
+}
+
+std::string_view TapeObject::stringViewForKey(std::string_view name, std::string_view defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isString()) {
+        return defaultValue;
+    }
+    return value->stringView();
+}
+
+std::string TapeObject::stringValueForKey(std::string_view name, const std::string& defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isString()) {
+        return defaultValue;
+    }
+    return value->stringValue();
+}
+
+int TapeObject::intValueForKey(std::string_view name, int defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isNumber()) {
+        return defaultValue;
+    }
+    return value->intValue();
+}
+
+int64_t TapeObject::int64ValueForKey(std::string_view name, int64_t defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isNumber()) {
+        return defaultValue;
+    }
+    return value->int64Value();
+}
+
+float TapeObject::floatValueForKey(std::string_view name, float defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isNumber()) {
+        return defaultValue;
+    }
+    return value->floatValue();
+}
+
+double TapeObject::doubleValueForKey(std::string_view name, double defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isNumber()) {
+        return defaultValue;
+    }
+    return value->doubleValue();
+}
+
+bool TapeObject::boolValueForKey(std::string_view name, bool defaultValue) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isBoolean()) {
+        return defaultValue;
+    }
+    return value->boolValue();
+}
+
+std::optional<TapeObject> TapeObject::objectForKey(std::string_view name) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isObject()) {
+        return std::nullopt;
+    }
+    return value->object();
+}
+
+std::optional<TapeArray> TapeObject::arrayForKey(std::string_view name) const {
+    const auto value = valueForKey(name);
+    if (!value || !value->isArray()) {
+        return std::nullopt;
+    }
+    return value->array();
+}
+
+TapeValue TapeArray::operator[] (size_t idx) const {
+    auto it = begin();
+    const auto last = end();
+    for (size_t i = 0; i < idx && it != last; i++) {
+        ++it;
+    }
+    if (it == last) {
+        throw OutOfBounds();
+    }
+    return *it;
+}
+
+TapeArray::Iterator TapeArray::begin() const {
+    return Iterator(TapeValue(mArray.mWords, mArray.mStrings, mArray.mIndex + 1));
+}
+
+TapeArray::Iterator TapeArray::end() const {
+    return Iterator(TapeValue(mArray.mWords, mArray.mStrings, mArray.mWords[mArray.mIndex] & TapeIndexMask));
+}
+
+void FileSink::write(const char* data, size_t length) {
+    if (fwrite(data, 1, length, mFile) != length) {
+        throw IOError("Failed to write all bytes to file");
+    }
+}
+
+void FdSink::write(const char* data, size_t length) {
+    while (length > 0) {
+#ifndef _WIN32
+        const ssize_t written = ::write(mFd, data, length);
+#else // !_WIN32
+        const int written = _write(mFd, data, static_cast<unsigned int>(std::min<size_t>(length, INT_MAX)));
+#endif // !_WIN32
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int err = errno;
+            throw IOError("Failed to write to file descriptor %d, errno: %d (%s)", mFd, err, strerror(err));
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+void BufferSink::write(const char* data, size_t length) {
+    if (length > mCapacity - mSize) {
+        throw OutOfBounds();
+    }
+    memcpy(mBuffer + mSize, data, length);
+    mSize += length;
+}
+
+// characters that are written as escape sequences, 0 for all others
+static const char* escapeSequence(unsigned char c) {
+    switch (c) {
+    case '\b': return "\\b";
+    case '\r': return "\\r";
+    case '\n': return "\\n";
+    case '\f': return "\\f";
+    case '\t': return "\\t";
+    case '\\': return "\\\\";
+    case '/': return "\\/";
+    case '\"': return "\\\"";
+    default: return nullptr;
+    }
+}
+
+struct EscapeTable {
+    EscapeTable() {
+        for (int i = 0; i < 256; i++) {
+            mNeedsEscape[i] = escapeSequence(static_cast<unsigned char>(i)) != nullptr;
+        }
+    }
+
+    bool mNeedsEscape[256];
+};
+
+static const EscapeTable s_EscapeTable;
+
+Serializer::Serializer(Sink& sink, bool prettyPrint, const std::string& indentation)
+: mSink(&sink),
+  mOutput(nullptr),
+  mPrettyPrint(prettyPrint),
+  mIndentation(indentation)
+{
+}
+
+Serializer::Serializer(std::string& output, bool prettyPrint, const std::string& indentation)
+: mSink(nullptr),
+  mOutput(&output),
+  mPrettyPrint(prettyPrint),
+  mIndentation(indentation)
+{
+}
+
+void Serializer::write(const Entity& entity, int level) {
+    writeEntity(entity, level);
+    flush();
+}
+
+void Serializer::append(const char* data, size_t length) {
+    if (length > mBufferSize - mBufferUsed) {
+        flush();
+        growBuffer();
+        if (length > mBufferSize) {
+            if (mSink) {
+                mSink->write(data, length);
+            } else {
+                mOutput->append(data, length);
+            }
+            return;
+        }
+    }
+    memcpy(mBuffer + mBufferUsed, data, length);
+    mBufferUsed += length;
+}
+
+void Serializer::append(char c) {
+    if (mBufferUsed == mBufferSize) {
+        flush();
+        growBuffer();
+    }
+    mBuffer[mBufferUsed++] = c;
+}
+
+// small output never allocates a buffer
+void Serializer::growBuffer() {
+    if (!mLargeBuffer) {
+        mLargeBuffer.reset(new char[BufferSize]);
+        mBuffer = mLargeBuffer.get();
+        mBufferSize = BufferSize;
+    }
+}
+
+void Serializer::flush() {
+    if (mBufferUsed > 0) {
+        if (mSink) {
+            mSink->write(mBuffer, mBufferUsed);
+        } else {
+            mOutput->append(mBuffer, mBufferUsed);
+        }
+        mBufferUsed = 0;
+    }
+}
+
+void Serializer::writeIndentation(int level) {
+    const size_t length = mIndentation.length() * level;
+    while (mIndentationCache.length() < length) {
+        mIndentationCache += mIndentation;
+    }
+    append(mIndentationCache.data(), length);
+}
+
+void Serializer::writeString(std::string_view str) {
+    append('"');
+    size_t runStart = 0;
+    for (size_t i = 0; i < str.length(); i++) {
+        const unsigned char c = static_cast<unsigned char>(str[i]);
+        if (!s_EscapeTable.mNeedsEscape[c]) {
+            continue;
+        }
+        append(str.data() + runStart, i - runStart);
+        append(escapeSequence(c), 2);
+        runStart = i + 1;
+    }
+    append(str.data() + runStart, str.length() - runStart);
+    append('"');
+}
+
+void Serializer::writeEntity(const Entity& entity, int level) {
+    switch (entity.type()) {
+    case Entity::Type::object:
+        writeObject(static_cast<const Object&>(entity), level);
+        break;
+    case Entity::Type::array:
+        writeArray(static_cast<const Array&>(entity), level);
+        break;
+    case Entity::Type::number: {
+            const auto& number = static_cast<const Number&>(entity);
+            if (number.mNumber.length() > 0) {
+                append(number.mNumber.view());
+            } else {
+                char buf[Number::s_MaxFormattedLength];
+                append(buf, number.format(buf));
+            }
+        }
+        break;
+    case Entity::Type::string:
+        writeString(static_cast<const String&>(entity).view());
+        break;
+    case Entity::Type::boolean:
+        append(static_cast<const Boolean&>(entity).value() ? std::string_view("true") : std::string_view("false"));
+        break;
+    case Entity::Type::null:
+        append(std::string_view("null"));
+        break;
+    case Entity::Type::comment:
+        append(std::string_view("//"));
+        append(static_cast<const Comment&>(entity).mText.view());
+        break;
+    }
+}
+
+// index after the last entity that is not a comment, entities before it are followed by a comma
+template<class Iterator, class GetEntity>
+static size_t commaLimit(Iterator begin, Iterator end, GetEntity getEntity) {
+    size_t limit = end - begin;
+    while (limit > 0 && getEntity(*(begin + (limit - 1))).type() == Entity::Type::comment) {
+        limit--;
+    }
+    return limit > 0 ? limit - 1 : 0;
+}
+
+void Serializer::writeObject(const Object& object, int level) {
+    object.materialize();
+    const auto& entities = object.mEntities;
+    const size_t commas = commaLimit(entities.begin(), entities.end(), [](const Object::KeyAndEntity& keyAndEntity) -> const Entity& {
+        return *keyAndEntity.mEntity;
+    });
+
+    if (mPrettyPrint) {
+        if (level > 0) {
+            append('\n');
+        }
+        writeIndentation(level);
+        append("{\n", 2);
+
+        for (size_t i = 0; i < entities.size(); i++) {
+            const auto& entityAndKey = entities[i];
+            const bool isComment = entityAndKey.mEntity->type() == Entity::Type::comment;
+
+            writeIndentation(level + 1);
+            if (!isComment) {
+                writeString(entityAndKey.mKey.view());
+                append(':');
+            }
+            writeEntity(*entityAndKey.mEntity, level + 1);
+            if (!isComment && i < commas) {
+                append(',');
+            }
+            append('\n');
+        }
+        append('\n');
+        writeIndentation(level);
+    } else {
+        append('{');
+        for (size_t i = 0; i < entities.size(); i++) {
+            const auto& entityAndKey = entities[i];
+            if (entityAndKey.mEntity->type() == Entity::Type::comment) {
+                continue;
+            }
+
+            writeString(entityAndKey.mKey.view());
+            append(':');
+            writeEntity(*entityAndKey.mEntity, level + 1);
+            if (i < commas) {
+                append(',');
+            }
+        }
+    }
+    append('}');
+}
+
+void Serializer::writeArray(const Array& array, int level) {
+    array.materialize();
+    const auto& values = array.mValues;
+    const size_t commas = commaLimit(values.begin(), values.end(), [](const Entity* entity) -> const Entity& {
+        return *entity;
+    });
+
+    append('[');
+    if (mPrettyPrint) {
+        append('\n');
+        for (size_t i = 0; i < values.size(); i++) {
+            writeIndentation(level + 1);
+            writeEntity(*values[i], level + 1);
+            if (values[i]->type() != Entity::Type::comment && i < commas) {
+                append(',');
+            }
+            append('\n');
+        }
+        writeIndentation(level);
+    } else {
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i]->type() == Entity::Type::comment) {
+                continue;
+            }
+
+            writeEntity(*values[i], level + 1);
+            if (i < commas) {
+                append(',');
+            }
+        }
+    }
+    append(']');
+}
+
+Writer::Writer(bool prettyPrint, const std::string& indentation, int level)
+: mPrettyPrint(prettyPrint),
+  mIndentation(indentation),
+  mLevel(level)
+{
+}
+
+void Writer::write(const std::string& path, const Entity& ent) {
+    auto* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        throw IOError("Failed to open file for writing");
+    }
+
+    try {
+        FileSink sink(f);
+        write(sink, ent);
+    } catch (...) {
+        fclose(f);
+        throw;
+    }
+
+    if (fclose(f) != 0) {
+        throw IOError("Failed to write all bytes to file");
+    }
+}
+
+void Writer::write(Sink& sink, const Entity& ent) {
+    Serializer(sink, mPrettyPrint, mIndentation).write(ent, mLevel);
+}
+
+void Writer::writeToFile(const std::string& path, const Entity& ent, bool prettyPrint, const std::string& indentation, int level) {
+
+    Writer writer(prettyPrint, indentation, level);
+    writer.write(path, ent);
+}
+
+// the end of a batch starting at begin, a batch ends at the first newline after s_BatchLength bytes
+static size_t ndjsonBatchEnd(const char* data, size_t begin, size_t length) {
+    if (length - begin <= NDJSONReader::s_BatchLength) {
+        return length;
+    }
+    const void* newline = memchr(data + begin + NDJSONReader::s_BatchLength, '\n', length - begin - NDJSONReader::s_BatchLength);
+    return newline ? static_cast<const char*>(newline) - data + 1 : length;
+}
+
+// calls onLine(number, json, error) for each line of [begin, end) that is not blank
+template<class F>
+static void parseLines(Parser& parser, const char* data, size_t begin, size_t end, size_t number, F&& onLine) {
+    for (size_t lineStart = begin; lineStart < end; number++) {
+        const void* newline = memchr(data + lineStart, '\n', end - lineStart);
+        const size_t lineEnd = newline ? static_cast<const char*>(newline) - data : end;
+        if (findNonWhitespace(data + lineStart, data + lineEnd) != data + lineEnd) {
+            std::optional<JSON> json;
+            std::exception_ptr error;
+            try {
+                json.emplace(parser.parse(data + lineStart, lineEnd - lineStart));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            onLine(number, json, error);
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+
+NDJSONReader::NDJSONReader() {
+}
+
+void NDJSONReader::allowComments(bool allow) {
+    mAllowComments = allow;
+}
+
+void NDJSONReader::setMaxDepth(size_t maxDepth) {
+    mMaxDepth = maxDepth;
+}
+
+void NDJSONReader::setThreads(size_t threads) {
+    mThreads = threads;
+}
+
+void NDJSONReader::setOrdered(bool ordered) {
+    mOrdered = ordered;
+}
+
+void NDJSONReader::setSkipBadLines(bool skip, ErrorCallback onError) {
+    mSkipBadLines = skip;
+    mOnError = std::move(onError);
+}
+
+size_t NDJSONReader::read(const std::string& data, const Callback& callback) {
+    return read(data.data(), data.length(), callback);
+}
+
+size_t NDJSONReader::load(const std::string& path, const Callback& callback) {
+    const MappedFile file(path);
+    return read(file.data(), file.size(), callback);
+}
+
+size_t NDJSONReader::read(const char* data, size_t length, const Callback& callback) {
+    struct Line {
+        size_t mNumber;
+        std::optional<JSON> mJson;
+        std::exception_ptr mError;
+    };
+    struct Batch {
+        std::vector<Line> mLines;
+    };
+
+    const size_t threads = mThreads ? mThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    // parsed batches waiting for delivery are limited, a slow callback stops the workers
+    const size_t maxPending = threads * 4;
+
+    std::mutex mutex;
+    std::condition_variable canTake;
+    std::condition_variable batchDone;
+    size_t position = 0;   // start of the next batch
+    size_t lineNumber = 1; // of the first line of the next batch
+    size_t taken = 0;      // batches taken by workers
+    size_t delivered = 0;  // batches passed to the callback
+    size_t running = threads;
+    bool stop = false;
+    std::map<size_t, Batch> done;
+
+    auto work = [&]() {
+        Parser parser;
+        parser.allowComments(mAllowComments);
+        parser.setMaxDepth(mMaxDepth);
+        while (true) {
+            size_t begin, end, number, index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                canTake.wait(lock, [&]() { return stop || position == length || taken - delivered < maxPending; });
+                if (stop || position == length) {
+                    break;
+                }
+                begin = position;
+                end = ndjsonBatchEnd(data, begin, length);
+                number = lineNumber;
+                lineNumber += std::count(data + begin, data + end, '\n');
+                position = end;
+                index = taken++;
+            }
+
+            Batch batch;
+            parseLines(parser, data, begin, end, number, [&batch](size_t line, std::optional<JSON>& json, std::exception_ptr error) {
+                batch.mLines.push_back(Line{line, std::move(json), error});
+            });
+
+            std::lock_guard<std::mutex> lock(mutex);
+            done.emplace(index, std::move(batch));
+            batchDone.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        running--;
+        batchDone.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    auto finish = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        canTake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    };
+
+    size_t count = 0;
+    try {
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(work);
+        }
+
+        bool stopped = false;
+        while (!stopped) {
+            Batch batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto next = [&]() { return mOrdered ? done.find(delivered) : done.begin(); };
+                batchDone.wait(lock, [&]() { return next() != done.end() || running == 0; });
+                const auto it = next();
+                if (it == done.end()) {
+                    break;
+                }
+                batch = std::move(it->second);
+                done.erase(it);
+                delivered++;
+            }
+            canTake.notify_all();
+
+            for (auto& line : batch.mLines) {
+                if (line.mError) {
+                    try {
+                        std::rethrow_exception(line.mError);
+                    } catch (const ParseError& error) {
+                        if (!mSkipBadLines) {
+                            throw;
+                        }
+                        if (mOnError && !mOnError(line.mNumber, error)) {
+                            stopped = true;
+                            break;
+                        }
+                    }
+                    continue;
+                }
+                count++;
+                if (!callback(line.mNumber, *line.mJson)) {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+    return count;
+}
+
+// Worker threads with one task queue each. Tasks are submitted round robin,
+// idle workers take the oldest tasks of other workers.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t threads);
+
+    // runs the remaining tasks before returning
+    ~WorkStealingPool();
+
+    void submit(std::function<void()> task);
+
+private:
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    void operator=(const WorkStealingPool&) = delete;
+
+    void run(size_t index);
+    bool take(size_t index, std::function<void()>& task);
+
+    struct Queue {
+        std::mutex mMutex;
+        std::deque<std::function<void()>> mTasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mThreads;
+    size_t mNextQueue = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    size_t mPending = 0;
+    bool mStop = false;
+};
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    for (size_t i = 0; i < threads; i++) {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        mThreads.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    // counted before it is queued, so mPending is never less than the queued tasks
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPending++;
+    }
+    auto& queue = *mQueues[mNextQueue++ % mQueues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mMutex);
+        queue.mTasks.push_back(std::move(task));
+    }
+    mWake.notify_one();
+}
+
+// the own queue is used from the front, other queues are stolen from at the back
+bool WorkStealingPool::take(size_t index, std::function<void()>& task) {
+    for (size_t i = 0; i < mQueues.size(); i++) {
+        auto& queue = *mQueues[(index + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(queue.mMutex);
+        if (!queue.mTasks.empty()) {
+            if (i == 0) {
+                task = std::move(queue.mTasks.front());
+                queue.mTasks.pop_front();
+            } else {
+                task = std::move(queue.mTasks.back());
+                queue.mTasks.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(size_t index) {
+    std::function<void()> task;
+    while (true) {
+        if (take(index, task)) {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mPending--;
+            }
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mPending == 0 && mStop) {
+            break;
+        }
+        mWake.wait(lock, [this]() { return mPending > 0 || mStop; });
+    }
+}
+
+NDJSONPipeline::NDJSONPipeline() {
+}
+
+void NDJSONPipeline::allowComments(bool allow) {
+    mAllowComments = allow;
+}
+
+void NDJSONPipeline::setMaxDepth(size_t maxDepth) {
+    mMaxDepth = maxDepth;
+}
+
+void NDJSONPipeline::setThreads(size_t threads) {
+    mThreads = threads;
+}
+
+void NDJSONPipeline::setQueueLength(size_t batches) {
+    mQueueLength = batches;
+}
+
+void NDJSONPipeline::setSkipBadLines(bool skip, NDJSONReader::ErrorCallback onError) {
+    mSkipBadLines = skip;
+    mOnError = std::move(onError);
+}
+
+size_t NDJSONPipeline::run(const std::string& data, Sink& sink, const Transform& transform) {
+    return run(data.data(), data.length(), sink, transform);
+}
+
+size_t NDJSONPipeline::load(const std::string& path, Sink& sink, const Transform& transform) {
+    const MappedFile file(path);
+    return run(file.data(), file.size(), sink, transform);
+}
+
+size_t NDJSONPipeline::run(const char* data, size_t length, Sink& sink, const Transform& transform) {
+    struct Batch {
+        size_t mBegin;
+        size_t mEnd;
+        size_t mFirstLine;
+        std::string mOutput;
+        size_t mRecords = 0;
+        std::vector<std::pair<size_t, std::exception_ptr>> mErrors;
+        std::exception_ptr mFailure; // thrown by the transform
+        bool mDone = false;
+    };
+
+    const size_t threads = mThreads ? mThreads : std::max(std::thread::hardware_concurrency(), 1u);
+    const size_t queueLength = mQueueLength ? mQueueLength : threads * 4;
+    const bool allowComments = mAllowComments;
+    const size_t maxDepth = mMaxDepth;
+
+    std::mutex mutex;
+    std::condition_variable batchDone;
+    std::atomic<bool> cancelled(false);
+
+    auto process = [&](Batch& batch) {
+        try {
+            if (cancelled) {
+                throw Exception("Pipeline cancelled");
+            }
+            Parser parser;
+            parser.allowComments(allowComments);
+            parser.setMaxDepth(maxDepth);
+            Serializer serializer(batch.mOutput, false);
+            parseLines(parser, data, batch.mBegin, batch.mEnd, batch.mFirstLine, [&](size_t line, std::optional<JSON>& json, std::exception_ptr error) {
+                if (error) {
+                    batch.mErrors.emplace_back(line, error);
+                } else if (transform(*json)) {
+                    serializer.write(json->root());
+                    batch.mOutput += '\n';
+                    batch.mRecords++;
+                }
+            });
+        } catch (...) {
+            batch.mFailure = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.mDone = true;
+        batchDone.notify_all();
+    };
+
+    std::deque<std::unique_ptr<Batch>> inFlight;
+    // destroyed before the batches, it finishes the queued ones, skipping their work when cancelled
+    WorkStealingPool pool(threads);
+
+    size_t position = 0;
+    size_t lineNumber = 1;
+    size_t records = 0;
+    try {
+        while (position < length || !inFlight.empty()) {
+            // read: queue batches until the queue is full
+            while (position < length && inFlight.size() < queueLength) {
+                const size_t end = ndjsonBatchEnd(data, position, length);
+                auto batch = std::make_unique<Batch>();
+                batch->mBegin = position;
+                batch->mEnd = end;
+                batch->mFirstLine = lineNumber;
+                lineNumber += std::count(data + position, data + end, '\n');
+                position = end;
+                Batch* queued = batch.get();
+                inFlight.push_back(std::move(batch));
+                pool.submit([&process, queued]() { process(*queued); });
+            }
+
+            // write: the oldest batch keeps the records in input order
+            Batch& batch = *inFlight.front();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                batchDone.wait(lock, [&batch]() { return batch.mDone; });
+            }
+            if (batch.mFailure) {
+                std::rethrow_exception(batch.mFailure);
+            }
+            // errors are reported before the records of their batch
+            for (const auto& error : batch.mErrors) {
+                try {
+                    std::rethrow_exception(error.second);
+                } catch (const ParseError& parseError) {
+                    if (!mSkipBadLines) {
+                        throw;
+                    }
+                    if (mOnError && !mOnError(error.first, parseError)) {
+                        cancelled = true;
+                        return records;
+                    }
+                }
+            }
+            sink.write(batch.mOutput.data(), batch.mOutput.size());
+            records += batch.mRecords;
+            inFlight.pop_front();
+        }
+    } catch (...) {
+        cancelled = true;
+        throw;
+    }
+    return records;
+}
+
+enum class BinaryFormat {
+    cbor,
+    messagePack
+};
+
+// Writes CBOR or MessagePack, output is collected and handed to the sink in large pieces
+class BinaryEncoder {
+public:
+    BinaryEncoder(Sink& sink, BinaryFormat format) :
+        mSink(sink),
+        mFormat(format) {
+    }
+
+    // writes the entity and flushes the output to the sink
+    void write(const Entity& entity) {
+        writeEntity(entity);
+        flush();
+    }
+
+private:
+    void writeEntity(const Entity& entity);
+    void writeInt(int64_t value);
+    void writeDouble(double value);
+    void writeString(std::string_view str);
+    void writeCBORHead(uint8_t major, uint64_t argument);
+    void writeMessagePackLength(uint64_t length, uint8_t fix, uint8_t fixLimit, uint8_t code16);
+    void writeBigEndian(uint64_t value, size_t bytes);
+
+    void append(char c) {
+        mBuffer += c;
+    }
+
+    void flush() {
+        mSink.write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+
+    static const size_t BufferSize = 64 * 1024;
+
+    Sink& mSink;
+    BinaryFormat mFormat;
+    std::string mBuffer;
+};
+
+void BinaryEncoder::writeBigEndian(uint64_t value, size_t bytes) {
+    for (size_t i = bytes; i > 0; i--) {
+        append(static_cast<char>(value >> ((i - 1) * 8)));
+    }
+}
+
+// the shortest of the 1 byte, 1, 2, 4 and 8 byte argument forms
+void BinaryEncoder::writeCBORHead(uint8_t major, uint64_t argument) {
+    const uint8_t type = static_cast<uint8_t>(major << 5);
+    if (argument < 24) {
+        append(static_cast<char>(type | argument));
+    } else if (argument <= 0xff) {
+        append(static_cast<char>(type | 24));
+        writeBigEndian(argument, 1);
+    } else if (argument <= 0xffff) {
+        append(static_cast<char>(type | 25));
+        writeBigEndian(argument, 2);
+    } else if (argument <= 0xffffffff) {
+        append(static_cast<char>(type | 26));
+        writeBigEndian(argument, 4);
+    } else {
+        append(static_cast<char>(type | 27));
+        writeBigEndian(argument, 8);
+    }
+}
+
+// fix formats up to fixLimit, then the 16 and 32 bit forms, whose codes follow each other
+void BinaryEncoder::writeMessagePackLength(uint64_t length, uint8_t fix, uint8_t fixLimit, uint8_t code16) {
+    if (length <= fixLimit) {
+        append(static_cast<char>(fix | length));
+    } else if (length <= 0xffff) {
+        append(static_cast<char>(code16));
+        writeBigEndian(length, 2);
+    } else {
+        append(static_cast<char>(code16 + 1));
+        writeBigEndian(length, 4);
+    }
+}
+
+void BinaryEncoder::writeInt(int64_t value) {
+    if (mFormat == BinaryFormat::cbor) {
+        if (value >= 0) {
+            writeCBORHead(0, static_cast<uint64_t>(value));
+        } else {
+            writeCBORHead(1, static_cast<uint64_t>(-(value + 1)));
+        }
+        return;
+    }
+
+    if (value >= 0) {
+        if (value < 128) {
+            append(static_cast<char>(value));
+        } else if (value <= 0xff) {
+            append(static_cast<char>(0xcc));
+            writeBigEndian(value, 1);
+        } else if (value <= 0xffff) {
+            append(static_cast<char>(0xcd));
+            writeBigEndian(value, 2);
+        } else if (value <= 0xffffffff) {
+            append(static_cast<char>(0xce));
+            writeBigEndian(value, 4);
+        } else {
+            append(static_cast<char>(0xcf));
+            writeBigEndian(value, 8);
+        }
+    } else if (value >= -32) {
+        append(static_cast<char>(value));
+    } else if (value >= INT8_MIN) {
+        append(static_cast<char>(0xd0));
+        writeBigEndian(static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN) {
+        append(static_cast<char>(0xd1));
+        writeBigEndian(static_cast<uint64_t>(value), 2);
+    } else if (value >= INT32_MIN) {
+        append(static_cast<char>(0xd2));
+        writeBigEndian(static_cast<uint64_t>(value), 4);
+    } else {
+        append(static_cast<char>(0xd3));
+        writeBigEndian(static_cast<uint64_t>(value), 8);
+    }
+}
+
+// single precision if it holds the value exactly
+void BinaryEncoder::writeDouble(double value) {
+    const float single = static_cast<float>(value);
+    if (static_cast<double>(single) == value) {
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        append(static_cast<char>(mFormat == BinaryFormat::cbor ? 0xfa : 0xca));
+        writeBigEndian(bits, 4);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        append(static_cast<char>(mFormat == BinaryFormat::cbor ? 0xfb : 0xcb));
+        writeBigEndian(bits, 8);
+    }
+}
+
+void BinaryEncoder::writeString(std::string_view str) {
+    if (mFormat == BinaryFormat::cbor) {
+        writeCBORHead(3, str.length());
+    } else if (str.length() <= 31) {
+        append(static_cast<char>(0xa0 | str.length()));
+    } else if (str.length() <= 0xff) {
+        append(static_cast<char>(0xd9));
+        writeBigEndian(str.length(), 1);
+    } else {
+        writeMessagePackLength(str.length(), 0xa0, 31, 0xda);
+    }
+    mBuffer.append(str.data(), str.length());
+}
+
+void BinaryEncoder::writeEntity(const Entity& entity) {
+    const bool cbor = mFormat == BinaryFormat::cbor;
+    switch (entity.type()) {
+    case Entity::Type::object: {
+        const auto& object = entity.object();
+        size_t count = 0;
+        for (const auto& member : object) {
+            count += member.entity().type() != Entity::Type::comment ? 1 : 0;
+        }
+        if (cbor) {
+            writeCBORHead(5, count);
+        } else {
+            writeMessagePackLength(count, 0x80, 15, 0xde);
+        }
+        for (const auto& member : object) {
+            if (member.entity().type() != Entity::Type::comment) {
+                writeString(member.keyView());
+                writeEntity(member.entity());
+            }
+        }
+        break;
+    }
+    case Entity::Type::array: {
+        const auto& array = entity.array();
+        size_t count = 0;
+        for (const auto* value : array) {
+            count += value->type() != Entity::Type::comment ? 1 : 0;
+        }
+        if (cbor) {
+            writeCBORHead(4, count);
+        } else {
+            writeMessagePackLength(count, 0x90, 15, 0xdc);
+        }
+        for (const auto* value : array) {
+            if (value->type() != Entity::Type::comment) {
+                writeEntity(*value);
+            }
+        }
+        break;
+    }
+    case Entity::Type::number: {
+        const auto& number = static_cast<const Number&>(entity);
+        if (number.isInteger()) {
+            writeInt(number.valueInt64());
+        } else {
+            writeDouble(number.valueDouble());
+        }
+        break;
+    }
+    case Entity::Type::string:
+        writeString(static_cast<const String&>(entity).view());
+        break;
+    case Entity::Type::boolean:
+        if (cbor) {
+            append(static_cast<char>(static_cast<const Boolean&>(entity).value() ? 0xf5 : 0xf4));
+        } else {
+            append(static_cast<char>(static_cast<const Boolean&>(entity).value() ? 0xc3 : 0xc2));
+        }
+        break;
+    case Entity::Type::null:
+        append(static_cast<char>(cbor ? 0xf6 : 0xc0));
+        break;
+    case Entity::Type::comment:
+        break;
+    }
+    if (mBuffer.size() >= BufferSize) {
+        flush();
+    }
+}
+
+// Builds entities from CBOR or MessagePack. The length prefixes of strings and
+// containers size their allocations up front.
+class BinaryDecoder {
+public:
+    BinaryDecoder(const char* data, size_t length, BinaryFormat format) :
+        mData(reinterpret_cast<const uint8_t*>(data)),
+        mLength(length),
+        mFormat(format) {
+    }
+
+    JSON decode();
+
+private:
+    static constexpr size_t s_MaxDepth = 64;
+
+    Entity* decodeCBOR(size_t depth);
+    Entity* decodeMessagePack(size_t depth);
+
+    uint8_t readByte();
+    uint64_t readBigEndian(size_t bytes);
+    std::string_view readBytes(uint64_t length);
+
+    // argument of a CBOR head, indefinite lengths are handled by the callers
+    uint64_t readCBORArgument(uint8_t info);
+    std::string_view readCBORString(uint8_t initial);
+    std::string_view readMessagePackKey();
+
+    Number* createInt(int64_t value);
+    Number* createUnsigned(uint64_t value);
+    Number* createDouble(double value, bool single = false);
+    String* createString(std::string_view value);
+    Array* createArray(size_t depth, uint64_t count, bool indefinite = false);
+    Object* createObject(size_t depth, uint64_t count, bool indefinite = false);
+
+    [[noreturn]] void fail(const char* message);
+
+    const uint8_t* mData;
+    size_t mLength;
+    size_t mPosition = 0;
+    BinaryFormat mFormat;
+    Arena* mArena = nullptr;
+
+    // chunks of indefinite length CBOR strings
+    std::string mStringBuffer;
+};
+
+void BinaryDecoder::fail(const char* message) {
+    throw ParseError(reinterpret_cast<const char*>(mData), mLength, mPosition, "%s", message);
+}
+
+uint8_t BinaryDecoder::readByte() {
+    if (mPosition == mLength) {
+        fail("Unexpected end of input");
+    }
+    return mData[mPosition++];
+}
+
+uint64_t BinaryDecoder::readBigEndian(size_t bytes) {
+    if (mLength - mPosition < bytes) {
+        fail("Unexpected end of input");
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | mData[mPosition++];
+    }
+    return value;
+}
+
+std::string_view BinaryDecoder::readBytes(uint64_t length) {
+    if (mLength - mPosition < length) {
+        fail("Unexpected end of input");
+    }
+    const std::string_view bytes(reinterpret_cast<const char*>(mData) + mPosition, static_cast<size_t>(length));
+    mPosition += static_cast<size_t>(length);
+    return bytes;
+}
+
+Number* BinaryDecoder::createInt(int64_t value) {
+    auto* num = Entity::create<Number>(mArena);
+    num->mIsInteger = true;
+    num->mInt = value;
+    return num;
+}
+
+Number* BinaryDecoder::createUnsigned(uint64_t value) {
+    if (value > static_cast<uint64_t>(INT64_MAX)) {
+        return createDouble(static_cast<double>(value));
+    }
+    return createInt(static_cast<int64_t>(value));
+}
+
+Number* BinaryDecoder::createDouble(double value, bool single) {
+    auto* num = Entity::create<Number>(mArena);
+    if (single) {
+        num->setFloat(static_cast<float>(value));
+    } else {
+        num->setDouble(value);
+    }
+    return num;
+}
+
+// short values share one copy like in parsed documents
+String* BinaryDecoder::createString(std::string_view value) {
+    auto* str = Entity::create<String>(mArena);
+    if (value.length() <= Parser::s_MaxInternedValueLength) {
+        const auto pooled = mArena->stringPool().intern(value);
+        str->mValue.reference(pooled.data(), pooled.length());
+    } else {
+        str->mValue.assign(mArena, value.data(), value.length());
+    }
+    return str;
+}
+
+// indefinite CBOR arrays are ended by a break instead of a count
+Array* BinaryDecoder::createArray(size_t depth, uint64_t count, bool indefinite) {
+    if (depth > s_MaxDepth) {
+        throw TooManyNestings(reinterpret_cast<const char*>(mData), mLength, mPosition);
+    }
+    auto* arr = Entity::create<Array>(mArena);
+    if (!indefinite) {
+        // every value takes at least one byte, a corrupt count cannot reserve more than the input
+        arr->mValues.reserve(static_cast<size_t>(std::min<uint64_t>(count, mLength - mPosition)));
+    }
+    for (uint64_t i = 0; indefinite || i < count; i++) {
+        if (indefinite && readByte() == 0xff) {
+            break;
+        } else if (indefinite) {
+            mPosition--;
+        }
+        arr->mValues.push_back(mFormat == BinaryFormat::cbor ? decodeCBOR(depth) : decodeMessagePack(depth));
+    }
+    return arr;
+}
+
+Object* BinaryDecoder::createObject(size_t depth, uint64_t count, bool indefinite) {
+    if (depth > s_MaxDepth) {
+        throw TooManyNestings(reinterpret_cast<const char*>(mData), mLength, mPosition);
+    }
+    auto* obj = Entity::create<Object>(mArena);
+    if (!indefinite) {
+        // every member takes at least two bytes
+        obj->mEntities.reserve(static_cast<size_t>(std::min<uint64_t>(count, (mLength - mPosition) / 2)));
+    }
+    for (uint64_t i = 0; indefinite || i < count; i++) {
+        std::string_view key;
+        if (mFormat == BinaryFormat::cbor) {
+            const uint8_t initial = readByte();
+            if (indefinite && initial == 0xff) {
+                break;
+            }
+            if ((initial >> 5) != 3) {
+                fail("Map keys have to be text strings");
+            }
+            key = readCBORString(initial);
+        } else {
+            key = readMessagePackKey();
+        }
+        const auto pooled = mArena->stringPool().intern(key);
+        StringData keyData;
+        keyData.reference(pooled.data(), pooled.length());
+        Entity* value = mFormat == BinaryFormat::cbor ? decodeCBOR(depth) : decodeMessagePack(depth);
+        obj->mEntities.emplace_back(keyData, value);
+    }
+    return obj;
+}
+
+uint64_t BinaryDecoder::readCBORArgument(uint8_t info) {
+    if (info < 24) {
+        return info;
+    }
+    switch (info) {
+    case 24: return readBigEndian(1);
+    case 25: return readBigEndian(2);
+    case 26: return readBigEndian(4);
+    case 27: return readBigEndian(8);
+    default: fail("Invalid additional information");
+    }
+}
+
+// text and byte strings, the chunks of indefinite strings are joined
+std::string_view BinaryDecoder::readCBORString(uint8_t initial) {
+    if ((initial & 31) != 31) {
+        return readBytes(readCBORArgument(initial & 31));
+    }
+    mStringBuffer.clear();
+    while (true) {
+        const uint8_t chunk = readByte();
+        if (chunk == 0xff) {
+            break;
+        }
+        if ((chunk >> 5) != (initial >> 5) || (chunk & 31) == 31) {
+            fail("Invalid chunk in indefinite length string");
+        }
+        const auto bytes = readBytes(readCBORArgument(chunk & 31));
+        mStringBuffer.append(bytes.data(), bytes.length());
+    }
+    return mStringBuffer;
+}
+
+static double decodeHalf(uint16_t half) {
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0) {
+        value = std::ldexp(mantissa, -24);
+    } else if (exponent != 31) {
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    } else {
+        value = mantissa == 0 ? INFINITY : NAN;
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+Entity* BinaryDecoder::decodeCBOR(size_t depth) {
+    uint8_t initial = readByte();
+    // tags only annotate the following item, chains of them are skipped without recursion
+    while ((initial >> 5) == 6) {
+        if ((initial & 31) == 31) {
+            fail("Invalid indefinite length");
+        }
+        readCBORArgument(initial & 31);
+        initial = readByte();
+    }
+    const uint8_t major = initial >> 5;
+    const uint8_t info = initial & 31;
+    if (info == 31 && major < 2) {
+        fail("Invalid indefinite length");
+    }
+    switch (major) {
+    case 0:
+        return createUnsigned(readCBORArgument(info));
+    case 1: {
+        const uint64_t argument = readCBORArgument(info);
+        if (argument > static_cast<uint64_t>(INT64_MAX)) {
+            return createDouble(-1.0 - static_cast<double>(argument));
+        }
+        return createInt(-1 - static_cast<int64_t>(argument));
+    }
+    case 2:
+    case 3:
+        return createString(readCBORString(initial));
+    case 4:
+        return info == 31 ? createArray(depth + 1, 0, true) : createArray(depth + 1, readCBORArgument(info));
+    case 5:
+        return info == 31 ? createObject(depth + 1, 0, true) : createObject(depth + 1, readCBORArgument(info));
+    default:
+        break;
+    }
+
+    switch (info) {
+    case 20:
+    case 21: {
+        auto* b = Entity::create<Boolean>(mArena);
+        b->setBool(info == 21);
+        return b;
+    }
+    case 22:
+    case 23:
+        // undefined has no JSON counterpart
+        return Entity::create<Null>(mArena);
+    case 25:
+        return createDouble(decodeHalf(static_cast<uint16_t>(readBigEndian(2))), true);
+    case 26: {
+        const uint32_t bits = static_cast<uint32_t>(readBigEndian(4));
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return createDouble(value, true);
+    }
+    case 27: {
+        const uint64_t bits = readBigEndian(8);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return createDouble(value);
+    }
+    default:
+        fail("Unsupported simple value");
+    }
+}
+
+std::string_view BinaryDecoder::readMessagePackKey() {
+    const uint8_t code = readByte();
+    if (code >= 0xa0 && code <= 0xbf) {
+        return readBytes(code & 0x1f);
+    }
+    switch (code) {
+    case 0xd9: return readBytes(readBigEndian(1));
+    case 0xda: return readBytes(readBigEndian(2));
+    case 0xdb: return readBytes(readBigEndian(4));
+    default: fail("Map keys have to be strings");
+    }
+}
+
+Entity* BinaryDecoder::decodeMessagePack(size_t depth) {
+    const uint8_t code = readByte();
+    if (code <= 0x7f) {
+        return createInt(code);
+    } else if (code >= 0xe0) {
+        return createInt(static_cast<int8_t>(code));
+    } else if (code <= 0x8f) {
+        return createObject(depth + 1, code & 0x0f);
+    } else if (code <= 0x9f) {
+        return createArray(depth + 1, code & 0x0f);
+    } else if (code <= 0xbf) {
+        return createString(readBytes(code & 0x1f));
+    }
+
+    switch (code) {
+    case 0xc0:
+        return Entity::create<Null>(mArena);
+    case 0xc2:
+    case 0xc3: {
+        auto* b = Entity::create<Boolean>(mArena);
+        b->setBool(code == 0xc3);
+        return b;
+    }
+    case 0xc4:
+    case 0xd9:
+        return createString(readBytes(readBigEndian(1)));
+    case 0xc5:
+    case 0xda:
+        return createString(readBytes(readBigEndian(2)));
+    case 0xc6:
+    case 0xdb:
+        return createString(readBytes(readBigEndian(4)));
+    case 0xca: {
+        const uint32_t bits = static_cast<uint32_t>(readBigEndian(4));
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return createDouble(value, true);
+    }
+    case 0xcb: {
+        const uint64_t bits = readBigEndian(8);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return createDouble(value);
+    }
+    case 0xcc: return createInt(static_cast<int64_t>(readBigEndian(1)));
+    case 0xcd: return createInt(static_cast<int64_t>(readBigEndian(2)));
+    case 0xce: return createInt(static_cast<int64_t>(readBigEndian(4)));
+    case 0xcf: return createUnsigned(readBigEndian(8));
+    case 0xd0: return createInt(static_cast<int8_t>(readBigEndian(1)));
+    case 0xd1: return createInt(static_cast<int16_t>(readBigEndian(2)));
+    case 0xd2: return createInt(static_cast<int32_t>(readBigEndian(4)));
+    case 0xd3: return createInt(static_cast<int64_t>(readBigEndian(8)));
+    case 0xdc: return createArray(depth + 1, readBigEndian(2));
+    case 0xdd: return createArray(depth + 1, readBigEndian(4));
+    case 0xde: return createObject(depth + 1, readBigEndian(2));
+    case 0xdf: return createObject(depth + 1, readBigEndian(4));
+    default:
+        fail("Unsupported MessagePack type");
+    }
+}
+
+JSON BinaryDecoder::decode() {
+    auto arena = std::make_unique<Arena>();
+    mArena = arena.get();
+    mPosition = 0;
+    Entity* root = mFormat == BinaryFormat::cbor ? decodeCBOR(0) : decodeMessagePack(0);
+    if (mPosition != mLength) {
+        fail("Extra bytes at end of input");
+    }
+    mArena = nullptr;
+    return JSON(std::move(arena), root);
+}
+
+void CBOR::encode(const Entity& entity, Sink& sink) {
+    BinaryEncoder(sink, BinaryFormat::cbor).write(entity);
+}
+
+std::string CBOR::encode(const Entity& entity) {
+    std::string data;
+    StringSink sink(data);
+    encode(entity, sink);
+    return data;
+}
+
+JSON CBOR::decode(const char* data, size_t length) {
+    return BinaryDecoder(data, length, BinaryFormat::cbor).decode();
+}
+
+JSON CBOR::decode(const std::string& data) {
+    return decode(data.data(), data.length());
+}
+
+void MessagePack::encode(const Entity& entity, Sink& sink) {
+    BinaryEncoder(sink, BinaryFormat::messagePack).write(entity);
+}
+
+std::string MessagePack::encode(const Entity& entity) {
+    std::string data;
+    StringSink sink(data);
+    encode(entity, sink);
+    return data;
+}
+
+JSON MessagePack::decode(const char* data, size_t length) {
+    return BinaryDecoder(data, length, BinaryFormat::messagePack).decode();
+}
+
+JSON MessagePack::decode(const std::string& data) {
+    return decode(data.data(), data.length());
+}
+
+Reader::Reader(const char* txt, size_t length) {
+    mParser.mText = txt;
+    mParser.mLength = length;
+}
+
+Reader::Reader(const std::string& txt) : Reader(txt.data(), txt.length()) {
+}
+
+void Reader::setMaxDepth(size_t maxDepth) {
+    mParser.setMaxDepth(maxDepth);
+}
+
+void Reader::fail(const char* message) {
+    throw ParseError(mParser.mText, mParser.mLength, mParser.mPosition, "%s at position %d", message, static_cast<int>(mParser.mPosition));
+}
+
+Entity::Type Reader::peek() {
+    mParser.skipWhitespaces();
+    const char c = mParser.curChar(false);
+    switch (c) {
+    case '{': return Entity::Type::object;
+    case '[': return Entity::Type::array;
+    case '"': return Entity::Type::string;
+    case 't':
+    case 'f': return Entity::Type::boolean;
+    case 'n': return Entity::Type::null;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return Entity::Type::number;
+        }
+        fail("Syntax error");
+    }
+}
 
-    auto* f = fopen(path.c_str(), "wb");
-    if (!f) {
-        throw IOError("Failed to open file for writing");
+void Reader::startObject() {
+    mParser.skipWhitespaces();
+    if (!mParser.tryToConsume("{")) {
+        fail("Expected object");
+    }
+    if (mFirst.size() >= mParser.mMaxDepth) {
+        throw TooManyNestings(mParser.mText, mParser.mLength, mParser.mPosition);
     }
+    mFirst.push_back(true);
+}
+
+bool Reader::nextKey(std::string_view& key) {
+    mParser.skipWhitespaces();
+    if (mParser.tryToConsume("}")) {
+        mFirst.pop_back();
+        return false;
+    }
+    if (mFirst.back()) {
+        mFirst.back() = false;
+    } else {
+        mParser.consumeOrDie(",");
+        mParser.skipWhitespaces();
+    }
+    if (mParser.curChar(false) != '"') {
+        fail("Expected key");
+    }
+    key = mParser.parseStringLiteral();
+    mParser.skipWhitespaces();
+    mParser.consumeOrDie(":");
+    return true;
+}
 
-    size_t wr = fwrite(json.c_str(), 1, json.length(), f);
-    fclose(f);
+void Reader::startArray() {
+    mParser.skipWhitespaces();
+    if (!mParser.tryToConsume("[")) {
+        fail("Expected array");
+    }
+    if (mFirst.size() >= mParser.mMaxDepth) {
+        throw TooManyNestings(mParser.mText, mParser.mLength, mParser.mPosition);
+    }
+    mFirst.push_back(true);
+}
 
-    if (wr != json.length()) {
-        throw IOError("Failed to write all bytes to file");
+bool Reader::nextElement() {
+    mParser.skipWhitespaces();
+    if (mParser.tryToConsume("]")) {
+        mFirst.pop_back();
+        return false;
+    }
+    if (mFirst.back()) {
+        mFirst.back() = false;
+    } else {
+        mParser.consumeOrDie(",");
     }
+    return true;
 }
 
-void Writer::writeToFile(const std::string& path, const Entity& ent, bool prettyPrint, const std::string& indentation, int level) {
+std::string_view Reader::readString() {
+    mParser.skipWhitespaces();
+    if (mParser.curChar(false) != '"') {
+        fail("Expected string");
+    }
+    return mParser.parseStringLiteral();
+}
 
-    Writer writer(prettyPrint, indentation, level);
-    writer.write(path, ent);
+bool Reader::readBoolean() {
+    mParser.skipWhitespaces();
+    if (mParser.tryToConsume("true")) {
+        return true;
+    }
+    if (!mParser.tryToConsume("false")) {
+        fail("Expected boolean");
+    }
+    return false;
+}
+
+std::string_view Reader::readNumber() {
+    mParser.skipWhitespaces();
+    const char c = mParser.curChar(false);
+    if (c != '-' && (c < '0' || c > '9')) {
+        fail("Expected number");
+    }
+    return mParser.scanNumber();
+}
+
+int64_t Reader::readInt64() {
+    int64_t i = 0;
+    double d = 0.0;
+    return parseNumberText(readNumber(), i, d) ? i : clampToInt64(d);
+}
+
+uint64_t Reader::readUInt64() {
+    const auto text = readNumber();
+    uint64_t u = 0;
+    const auto result = std::from_chars(text.data(), text.data() + text.length(), u);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.length()) {
+        return u;
+    }
+
+    // negative values, fractions, exponents and values exceeding 64 bit
+    int64_t i = 0;
+    double d = 0.0;
+    if (parseNumberText(text, i, d)) {
+        return i < 0 ? 0 : static_cast<uint64_t>(i);
+    }
+    if (!(d > 0.0)) {
+        return 0;
+    }
+    if (d >= 18446744073709551616.0) {
+        return UINT64_MAX;
+    }
+    return static_cast<uint64_t>(d);
+}
+
+double Reader::readDouble() {
+    int64_t i = 0;
+    double d = 0.0;
+    return parseNumberText(readNumber(), i, d) ? static_cast<double>(i) : d;
+}
+
+bool Reader::readNull() {
+    mParser.skipWhitespaces();
+    return mParser.tryToConsume("null");
+}
+
+void Reader::skipValue() {
+    mParser.skipWhitespaces();
+    Handler validator;
+    mParser.parseValueEvents(validator, mFirst.size());
+}
+
+JSON Reader::readDocument() {
+    mParser.skipWhitespaces();
+    auto arena = std::make_unique<Arena>();
+    mParser.mArena = arena.get();
+    mParser.mValueStack.clear();
+    mParser.mMemberStack.clear();
+    Entity* root = nullptr;
+    try {
+        root = mParser.parseValue(mFirst.size());
+    } catch (...) {
+        mParser.mArena = nullptr;
+        throw;
+    }
+    mParser.mArena = nullptr;
+    return JSON(std::move(arena), root);
+}
+
+void Reader::finish() {
+    mParser.skipWhitespaces();
+    if (mParser.mPosition != mParser.mLength) {
+        fail("Extra bytes at end of json");
+    }
+}
+
+EventWriter::EventWriter(Sink& sink) : mSerializer(sink, false) {
+}
+
+EventWriter::EventWriter(std::string& output) : mSerializer(output, false) {
+}
+
+void EventWriter::separate() {
+    if (mAfterKey) {
+        mAfterKey = false;
+    } else if (!mFirst.empty()) {
+        if (!mFirst.back()) {
+            mSerializer.append(',');
+        }
+        mFirst.back() = false;
+    }
+}
+
+void EventWriter::endValue() {
+    if (mFirst.empty()) {
+        mSerializer.flush();
+    }
+}
+
+bool EventWriter::startObject() {
+    separate();
+    mSerializer.append('{');
+    mFirst.push_back(true);
+    return true;
+}
+
+bool EventWriter::key(std::string_view key) {
+    separate();
+    mSerializer.writeString(key);
+    mSerializer.append(':');
+    mAfterKey = true;
+    return true;
+}
+
+bool EventWriter::endObject() {
+    mSerializer.append('}');
+    mFirst.pop_back();
+    endValue();
+    return true;
+}
+
+bool EventWriter::startArray() {
+    separate();
+    mSerializer.append('[');
+    mFirst.push_back(true);
+    return true;
+}
+
+bool EventWriter::endArray() {
+    mSerializer.append(']');
+    mFirst.pop_back();
+    endValue();
+    return true;
+}
+
+bool EventWriter::string(std::string_view value) {
+    separate();
+    mSerializer.writeString(value);
+    endValue();
+    return true;
+}
+
+bool EventWriter::number(std::string_view number) {
+    separate();
+    mSerializer.append(number);
+    endValue();
+    return true;
+}
+
+bool EventWriter::boolean(bool value) {
+    separate();
+    mSerializer.append(value ? std::string_view("true") : std::string_view("false"));
+    endValue();
+    return true;
+}
+
+bool EventWriter::null() {
+    separate();
+    mSerializer.append(std::string_view("null"));
+    endValue();
+    return true;
+}
+
+// a comment is not a value, the next one still gets its comma
+bool EventWriter::comment(std::string_view text) {
+    mSerializer.append(std::string_view("//"));
+    mSerializer.append(text);
+    mSerializer.append('\n');
+    endValue();
+    return true;
+}
+
+struct JSONPath::Segment {
+    enum class Kind {
+        key,
+        index,
+        wildcard,
+        slice,
+        filter
+    };
+
+    enum class Op {
+        exists,
+        equal,
+        notEqual,
+        less,
+        lessEqual,
+        greater,
+        greaterEqual
+    };
+
+    // negative indices count from the end of the array, its length has to be counted first
+    bool needsLength() const {
+        return (mKind == Kind::index || mKind == Kind::slice) && (mStart < 0 || mEnd < 0);
+    }
+
+    bool matchesIndex(size_t index, size_t length) const {
+        const auto resolve = [length](int64_t i) {
+            return i >= 0 ? i : std::max<int64_t>(static_cast<int64_t>(length) + i, 0);
+        };
+        const int64_t i = static_cast<int64_t>(index);
+        if (mKind == Kind::index) {
+            return mStart >= 0 ? i == mStart : static_cast<int64_t>(length) + mStart == i;
+        }
+        const int64_t start = resolve(mStart);
+        return i >= start && i < resolve(mEnd) && (i - start) % mStep == 0;
+    }
+
+    Kind mKind = Kind::key;
+    // matches all descendants of the current value instead of its children
+    bool mDescendant = false;
+    std::string mKey;
+    // index in mStart, slices from mStart up to mEnd
+    int64_t mStart = 0;
+    int64_t mEnd = INT64_MAX;
+    int64_t mStep = 1;
+
+    // filters: the keys from @ to the tested value and the literal it is compared to
+    std::vector<std::string> mFilterKeys;
+    Op mOp = Op::exists;
+    Entity::Type mLiteralType = Entity::Type::null;
+    std::string mString;
+    double mNumber = 0.0;
+    bool mBoolean = false;
+};
+
+// parses the text of a JSONPath into its segments
+class PathCompiler {
+public:
+    explicit PathCompiler(std::string_view path) : mPath(path) {
+    }
+
+    std::vector<JSONPath::Segment> compile() {
+        std::vector<JSONPath::Segment> segments;
+        expect('$');
+        while (mPosition < mPath.length()) {
+            JSONPath::Segment segment;
+            if (tryToConsume("..")) {
+                segment.mDescendant = true;
+                if (tryToConsume("[")) {
+                    parseBracket(segment);
+                } else {
+                    parseName(segment);
+                }
+            } else if (tryToConsume(".")) {
+                parseName(segment);
+            } else if (tryToConsume("[")) {
+                parseBracket(segment);
+            } else {
+                fail("Expected '.' or '['");
+            }
+            segments.push_back(std::move(segment));
+        }
+        return segments;
+    }
+
+private:
+    using Segment = JSONPath::Segment;
+
+    [[noreturn]] void fail(const char* message) {
+        throw ParseError(mPath.data(), mPath.length(), mPosition, "%s at position %d of JSONPath", message, static_cast<int>(mPosition));
+    }
+
+    char peek() const { return mPosition < mPath.length() ? mPath[mPosition] : '\0'; }
+
+    bool tryToConsume(std::string_view txt) {
+        if (mPath.substr(mPosition, txt.length()) != txt) {
+            return false;
+        }
+        mPosition += txt.length();
+        return true;
+    }
+
+    void expect(char c) {
+        if (peek() != c) {
+            throw ParseError(mPath.data(), mPath.length(), mPosition, "Expected '%c' at position %d of JSONPath", c, static_cast<int>(mPosition));
+        }
+        mPosition++;
+    }
+
+    void skipSpaces() {
+        while (peek() == ' ') {
+            mPosition++;
+        }
+    }
+
+    // member names after a dot end at the next dot or bracket, in filters also at spaces and operators
+    std::string parseIdentifier(bool inFilter) {
+        const size_t start = mPosition;
+        while (mPosition < mPath.length()) {
+            const char c = mPath[mPosition];
+            if (c == '.' || c == '[' || (inFilter && strchr(" )]=!<>", c))) {
+                break;
+            }
+            mPosition++;
+        }
+        if (mPosition == start) {
+            fail("Expected name");
+        }
+        return std::string(mPath.substr(start, mPosition - start));
+    }
+
+    void parseName(Segment& segment) {
+        if (tryToConsume("*")) {
+            segment.mKind = Segment::Kind::wildcard;
+            return;
+        }
+        segment.mKey = parseIdentifier(false);
+    }
+
+    // quoted with ' or ", backslash escapes the next character
+    std::string parseString() {
+        const char quote = mPath[mPosition++];
+        std::string str;
+        while (true) {
+            if (mPosition >= mPath.length()) {
+                fail("Closing quote not found");
+            }
+            char c = mPath[mPosition++];
+            if (c == quote) {
+                return str;
+            }
+            if (c == '\\' && mPosition < mPath.length()) {
+                c = mPath[mPosition++];
+            }
+            str += c;
+        }
+    }
+
+    int64_t parseInteger() {
+        const char* begin = mPath.data() + mPosition;
+        int64_t value = 0;
+        const auto result = std::from_chars(begin, mPath.data() + mPath.length(), value);
+        if (result.ec != std::errc()) {
+            fail("Expected integer");
+        }
+        mPosition += result.ptr - begin;
+        return value;
+    }
+
+    // the opening bracket has been consumed
+    void parseBracket(Segment& segment) {
+        skipSpaces();
+        const char c = peek();
+        if (c == '\'' || c == '"') {
+            segment.mKey = parseString();
+        } else if (tryToConsume("*")) {
+            segment.mKind = Segment::Kind::wildcard;
+        } else if (tryToConsume("?")) {
+            parseFilter(segment);
+        } else {
+            parseIndexOrSlice(segment);
+        }
+        skipSpaces();
+        expect(']');
+    }
+
+    void parseIndexOrSlice(Segment& segment) {
+        int64_t values[3] = {};
+        bool present[3] = {};
+        size_t parts = 0;
+        while (true) {
+            skipSpaces();
+            if (peek() == '-' || (peek() >= '0' && peek() <= '9')) {
+                values[parts] = parseInteger();
+                present[parts] = true;
+            }
+            skipSpaces();
+            parts++;
+            if (parts == 3 || !tryToConsume(":")) {
+                break;
+            }
+        }
+
+        if (parts == 1) {
+            if (!present[0]) {
+                fail("Expected index");
+            }
+            segment.mKind = Segment::Kind::index;
+            segment.mStart = values[0];
+            return;
+        }
+        segment.mKind = Segment::Kind::slice;
+        segment.mStart = present[0] ? values[0] : 0;
+        segment.mEnd = present[1] ? values[1] : INT64_MAX;
+        segment.mStep = present[2] ? values[2] : 1;
+        if (segment.mStep <= 0) {
+            fail("Only positive slice steps are supported");
+        }
+    }
+
+    void parseFilter(Segment& segment) {
+        segment.mKind = Segment::Kind::filter;
+        skipSpaces();
+        const bool parenthesized = tryToConsume("(");
+        skipSpaces();
+        expect('@');
+        while (true) {
+            if (tryToConsume(".")) {
+                segment.mFilterKeys.push_back(parseIdentifier(true));
+            } else if (tryToConsume("[")) {
+                skipSpaces();
+                if (peek() != '\'' && peek() != '"') {
+                    fail("Expected quoted key");
+                }
+                segment.mFilterKeys.push_back(parseString());
+                skipSpaces();
+                expect(']');
+            } else {
+                break;
+            }
+        }
+        skipSpaces();
+
+        static const std::pair<const char*, Segment::Op> ops[] = {
+            {"==", Segment::Op::equal}, {"!=", Segment::Op::notEqual}, {"<=", Segment::Op::lessEqual},
+            {">=", Segment::Op::greaterEqual}, {"<", Segment::Op::less}, {">", Segment::Op::greater}
+        };
+        for (const auto& op : ops) {
+            if (tryToConsume(op.first)) {
+                segment.mOp = op.second;
+                skipSpaces();
+                parseLiteral(segment);
+                skipSpaces();
+                break;
+            }
+        }
+        if (parenthesized) {
+            expect(')');
+        }
+    }
+
+    void parseLiteral(Segment& segment) {
+        const char c = peek();
+        if (c == '\'' || c == '"') {
+            segment.mLiteralType = Entity::Type::string;
+            segment.mString = parseString();
+        } else if (tryToConsume("true") || tryToConsume("false")) {
+            segment.mLiteralType = Entity::Type::boolean;
+            segment.mBoolean = c == 't';
+        } else if (tryToConsume("null")) {
+            segment.mLiteralType = Entity::Type::null;
+        } else {
+            const char* begin = mPath.data() + mPosition;
+            const auto result = parseDouble(begin, mPath.data() + mPath.length(), segment.mNumber);
+            if (result.ec != std::errc()) {
+                fail("Expected literal");
+            }
+            mPosition += result.ptr - begin;
+            segment.mLiteralType = Entity::Type::number;
+        }
+    }
+
+    std::string_view mPath;
+    size_t mPosition = 0;
+};
+
+// Walks the text with a Reader. The states of a value are the indices of the
+// segments that apply to its children, a value with all segments applied matches.
+class PathEvaluator {
+public:
+    PathEvaluator(const JSONPath& path, const char* txt, size_t length, const JSONPath::Callback& callback)
+    : mSegments(path.mSegments),
+      mReader(txt, length),
+      mCallback(callback)
+    {
+    }
+
+    bool run() {
+        // sized once, references to the states of the parents stay valid
+        mStates.resize(mReader.maxDepth() + 2);
+        mStates[0].push_back(0);
+        if (!walk(0)) {
+            return false;
+        }
+        mReader.finish();
+        return true;
+    }
+
+private:
+    using Segment = JSONPath::Segment;
+
+    // the value at the reader position with the states in mStates[depth]
+    bool walk(size_t depth) {
+        const auto& states = mStates[depth];
+        const bool matched = states.back() == mSegments.size();
+        const bool descend = states.front() < mSegments.size();
+
+        const auto type = descend ? mReader.peek() : Entity::Type::null;
+        if (type != Entity::Type::object && type != Entity::Type::array) {
+            if (matched) {
+                return emit();
+            }
+            mReader.skipValue();
+            return true;
+        }
+
+        // the match is read as a document, then again for the matches inside it
+        if (matched) {
+            const size_t start = mReader.position();
+            if (!emit()) {
+                return false;
+            }
+            mReader.rewind(start);
+        }
+
+        auto& childStates = mStates[depth + 1];
+        if (type == Entity::Type::object) {
+            mReader.startObject();
+            std::string_view key;
+            while (mReader.nextKey(key)) {
+                childStates.clear();
+                for (const auto state : states) {
+                    if (state == mSegments.size()) {
+                        continue;
+                    }
+                    const auto& segment = mSegments[state];
+                    if (segment.mDescendant) {
+                        childStates.push_back(state);
+                    }
+                    if ((segment.mKind == Segment::Kind::key && segment.mKey == key) || segment.mKind == Segment::Kind::wildcard) {
+                        childStates.push_back(state + 1);
+                    }
+                }
+                // the key is not used anymore, filters read the value
+                if (!walkChild(depth)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t length = std::string::npos;
+        for (const auto state : states) {
+            if (state < mSegments.size() && mSegments[state].needsLength()) {
+                length = countElements();
+                break;
+            }
+        }
+        mReader.startArray();
+        for (size_t index = 0; mReader.nextElement(); index++) {
+            childStates.clear();
+            for (const auto state : states) {
+                if (state == mSegments.size()) {
+                    continue;
+                }
+                const auto& segment = mSegments[state];
+                if (segment.mDescendant) {
+                    childStates.push_back(state);
+                }
+                if (segment.mKind == Segment::Kind::wildcard
+                    || ((segment.mKind == Segment::Kind::index || segment.mKind == Segment::Kind::slice) && segment.matchesIndex(index, length))) {
+                    childStates.push_back(state + 1);
+                }
+            }
+            if (!walkChild(depth)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // adds the filters matching the child to its states and walks it, skips it without states
+    bool walkChild(size_t depth) {
+        auto& childStates = mStates[depth + 1];
+        for (const auto state : mStates[depth]) {
+            if (state < mSegments.size() && mSegments[state].mKind == Segment::Kind::filter && test(mSegments[state])) {
+                childStates.push_back(state + 1);
+            }
+        }
+        if (childStates.empty()) {
+            mReader.skipValue();
+            return true;
+        }
+        std::sort(childStates.begin(), childStates.end());
+        childStates.erase(std::unique(childStates.begin(), childStates.end()), childStates.end());
+        return walk(depth + 1);
+    }
+
+    bool emit() {
+        JSON match = mReader.readDocument();
+        return mCallback(match);
+    }
+
+    size_t countElements() {
+        const size_t start = mReader.position();
+        size_t count = 0;
+        mReader.startArray();
+        while (mReader.nextElement()) {
+            mReader.skipValue();
+            count++;
+        }
+        mReader.rewind(start);
+        return count;
+    }
+
+    // tests the filter on the value at the reader position, the value is not consumed
+    bool test(const Segment& segment) {
+        const size_t start = mReader.position();
+        const size_t depth = mReader.mFirst.size();
+        const bool result = testValue(segment, 0);
+        mReader.rewind(start);
+        mReader.mFirst.resize(depth);
+        return result;
+    }
+
+    bool testValue(const Segment& segment, size_t keyIndex) {
+        if (keyIndex < segment.mFilterKeys.size()) {
+            if (mReader.peek() != Entity::Type::object) {
+                return false;
+            }
+            mReader.startObject();
+            std::string_view key;
+            while (mReader.nextKey(key)) {
+                if (key == segment.mFilterKeys[keyIndex]) {
+                    return testValue(segment, keyIndex + 1);
+                }
+                mReader.skipValue();
+            }
+            return false;
+        }
+        if (segment.mOp == Segment::Op::exists) {
+            return true;
+        }
+
+        const auto type = mReader.peek();
+        if (type != segment.mLiteralType) {
+            return segment.mOp == Segment::Op::notEqual;
+        }
+        int order = 0;
+        switch (type) {
+        case Entity::Type::number: {
+                const double value = mReader.readDouble();
+                order = value < segment.mNumber ? -1 : (value > segment.mNumber ? 1 : 0);
+            }
+            break;
+        case Entity::Type::string:
+            order = mReader.readString().compare(segment.mString);
+            break;
+        case Entity::Type::boolean:
+            if (mReader.readBoolean() != segment.mBoolean) {
+                return segment.mOp == Segment::Op::notEqual;
+            }
+            break;
+        default:
+            break;
+        }
+
+        // true, false and null are only equal or not
+        const bool ordered = type == Entity::Type::number || type == Entity::Type::string;
+        switch (segment.mOp) {
+        case Segment::Op::equal: return order == 0;
+        case Segment::Op::notEqual: return order != 0;
+        case Segment::Op::less: return ordered && order < 0;
+        case Segment::Op::lessEqual: return ordered && order <= 0;
+        case Segment::Op::greater: return ordered && order > 0;
+        case Segment::Op::greaterEqual: return ordered && order >= 0;
+        default: return true;
+        }
+    }
+
+    const std::vector<Segment>& mSegments;
+    Reader mReader;
+    const JSONPath::Callback& mCallback;
+
+    // the states of the values on the current path, sorted
+    std::vector<std::vector<uint32_t>> mStates;
+};
+
+JSONPath::JSONPath(std::string_view path)
+: mPath(path),
+  mSegments(PathCompiler(path).compile())
+{
+}
+
+JSONPath::~JSONPath() = default;
+
+JSONPath::JSONPath(JSONPath&&) noexcept = default;
+
+JSONPath& JSONPath::operator=(JSONPath&&) noexcept = default;
+
+bool JSONPath::evaluate(const char* txt, size_t length, const Callback& callback) const {
+    return PathEvaluator(*this, txt, length, callback).run();
+}
+
+bool JSONPath::evaluate(const std::string& txt, const Callback& callback) const {
+    return evaluate(txt.data(), txt.length(), callback);
+}
+
+bool JSONPath::load(const std::string& path, const Callback& callback) const {
+    MappedFile file(path);
+    return evaluate(file.data(), file.size(), callback);
+}
+
+std::vector<JSON> JSONPath::select(const std::string& txt) const {
+    std::vector<JSON> matches;
+    evaluate(txt, [&matches](JSON& match) {
+        matches.push_back(std::move(match));
+        return true;
+    });
+    return matches;
 }
 
 } // cson
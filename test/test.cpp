@@ -1,5 +1,7 @@
 #include <cson.h>
 #include <stdio.h>
+#include <climits>
+#include <cmath>
 
 
 const char* JSON_TYPES = R"JSON(
@@ -150,6 +152,963 @@ void testIterators() {
     TEST_TRUE(testString == "abc");
 }
 
+void testStrings() {
+    // long runs cross the 16/32 byte blocks of the vectorized scanner
+    std::string longText(100, 'x');
+    for (size_t offset = 0; offset < 40; offset++) {
+        std::string raw = longText.substr(0, offset) + "\\\"" + longText + "\\u00e4\\u20ac";
+        const auto json = JSON::fromString("[\"" + raw + "\"]");
+        const std::string expected = longText.substr(0, offset) + "\"" + longText + "\xc3\xa4\xe2\x82\xac";
+        if (json.array()[0].stringValue() != expected) {
+            FAIL("TEST_TRUE", json.array()[0].stringValue() == expected);
+        }
+    }
+    SUCCESS("TEST_TRUE", escapes at all block offsets);
+
+    const auto json = JSON::fromString(R"({"key with \"quotes\"": "\u0041\t", "plain": "no escapes at all in this rather long string value"})");
+    TEST_TRUE(json.object()["key with \"quotes\""].stringValue() == "A\t");
+    TEST_TRUE(json.object()["plain"].stringValue() == "no escapes at all in this rather long string value");
+}
+
+void testWhitespace() {
+    // indentation runs of all lengths around the 16 byte blocks of the vectorized skipping
+    for (size_t indent = 0; indent < 40; indent++) {
+        const std::string ws = "\r\n" + std::string(indent, ' ') + "\t";
+        const std::string input = "{" + ws + "\"a\"" + ws + ":" + ws + "[" + ws + "true" + ws + "," + ws + "null" + ws + "]" + ws + "}" + ws;
+        const auto json = JSON::fromString(input);
+        Handler handler;
+        if (json.object()["a"].array().count() != 2 || !Parser().parse(input, handler)) {
+            FAIL("TEST_TRUE", json.object()["a"].array().count() == 2);
+        }
+    }
+    SUCCESS("TEST_TRUE", whitespace runs of all lengths);
+}
+
+void testStructuralIndex() {
+    // enough short values to keep the documents below on stage 2 instead of the text parser
+    std::string dense;
+    for (int i = 0; i < 32; i++) {
+        dense += ", 0";
+    }
+
+    // runs of backslashes before a quote end the string or not, across the 64 byte blocks of stage 1
+    for (size_t offset = 0; offset < 70; offset++) {
+        for (size_t backslashes = 1; backslashes <= 4; backslashes++) {
+            // an odd run escapes the quote, an even one is followed by the closing quote
+            const std::string raw = std::string(offset, 'x') + std::string(backslashes, '\\') + (backslashes % 2 ? "\"" : "");
+            const std::string expected = std::string(offset, 'x') + std::string(backslashes / 2, '\\') + (backslashes % 2 ? "\"" : "");
+            const auto json = JSON::fromString("[\"" + raw + "\", {\"a\": [1, true]}" + dense + "]");
+            if (json.array().count() != 34 || json.array()[0].stringValue() != expected || json.array()[1].object()["a"].array()[0].intValue() != 1) {
+                FAIL("TEST_TRUE", json.array().count() == 34);
+            }
+        }
+    }
+    SUCCESS("TEST_TRUE", backslash runs at all block offsets);
+
+    // many small windows followed by a string longer than a window
+    const std::string longText(20000, 'y');
+    std::string input = "[";
+    for (int i = 0; i < 5000; i++) {
+        input += "{\"n\":" + std::to_string(i) + "},";
+    }
+    input += "\"" + longText + "\"]";
+    const auto json = JSON::fromString(input);
+    TEST_TRUE(json.array().count() == 5001);
+    TEST_TRUE(json.array()[4999].object()["n"].intValue() == 4999);
+    TEST_TRUE(json.array()[5000].stringValue() == longText);
+
+    // documents made of long strings are parsed from the text
+    const auto strings = JSON::fromString("[\"" + longText + "\", \"" + longText + "\"]");
+    TEST_TRUE(strings.array().count() == 2 && strings.array()[1].stringValue() == longText);
+}
+
+void testZeroCopy() {
+    const std::string input = R"({"plain": "referenced", "escaped": "\"copied\"", "num": 12})";
+    const auto json = JSON::fromString(input, { JSON::Option::zeroCopy });
+    const auto& obj = json.object();
+
+    const auto plain = obj.stringViewForKey("plain");
+    TEST_TRUE(plain == "referenced");
+    TEST_TRUE(plain.data() >= input.data() && plain.data() < input.data() + input.size());
+    TEST_TRUE(obj["escaped"].stringView() == "\"copied\"");
+    TEST_TRUE(obj["escaped"].stringView().data() < input.data() || obj["escaped"].stringView().data() >= input.data() + input.size());
+    TEST_TRUE(obj["num"].intValue() == 12);
+    TEST_TRUE(obj.begin()->keyView().data() > input.data());
+
+    // the document owns a moved input
+    std::string owned = input;
+    const auto ownedJson = JSON::fromString(std::move(owned), { JSON::Option::zeroCopy });
+    owned = "overwritten";
+    TEST_TRUE(ownedJson.object().stringViewForKey("plain") == "referenced");
+    TEST_TRUE(ownedJson.object()["plain"].stringValue() == "referenced");
+}
+
+void testNumbers() {
+    const std::string input = R"([1, -7, 2.50, 1e+2, 9223372036854775808, 3000000000])";
+    const auto json = JSON::fromString(input);
+    const auto& arr = json.array();
+    TEST_TRUE(arr[0].number().isInteger() && arr[0].number().valueInt64() == 1);
+    TEST_TRUE(arr[1].intValue() == -7);
+    TEST_TRUE(!arr[2].number().isInteger() && arr[2].doubleValue() == 2.5);
+    TEST_TRUE(arr[3].number().valueInt() == 100);
+    TEST_TRUE(!arr[4].number().isInteger());
+    TEST_TRUE(arr[5].number().valueInt64() == 3000000000 && arr[5].intValue() == INT_MAX);
+    TEST_TRUE(json.toString(json.root()) == "[1,-7,2.5,100,9223372036854775808,3000000000]");
+
+    const auto preserved = JSON::fromString(input, { JSON::Option::preserveNumbers });
+    TEST_TRUE(preserved.array()[2].number().value() == "2.50");
+    TEST_TRUE(preserved.toString(preserved.root()) == "[1,-7,2.50,1e+2,9223372036854775808,3000000000]");
+
+    // negative zero keeps its sign
+    const auto zeros = JSON::fromString("[-0, 0]");
+    TEST_TRUE(std::signbit(zeros.array()[0].doubleValue()) && zeros.array()[1].number().isInteger());
+    TEST_TRUE(zeros.toString(zeros.root()) == "[-0,0]");
+
+    Number num;
+    num.setInt(42);
+    TEST_TRUE(num.value() == "42" && num.valueDouble() == 42.0);
+    num.setDouble(0.25);
+    TEST_TRUE(num.value() == "0.25" && num.valueInt() == 0);
+    num.setDouble(1e-9);
+    TEST_TRUE(num.value() == "1e-09" && JSON::fromString("[" + num.value() + "]").array()[0].doubleValue() == 1e-9);
+    num.setDouble(0.1 + 0.2);
+    TEST_TRUE(num.value() == "0.30000000000000004");
+    num.setFloat(0.1f);
+    TEST_TRUE(num.value() == "0.1" && num.valueFloat() == 0.1f);
+    num.setInt(INT_MIN);
+    TEST_TRUE(num.value() == "-2147483648");
+    num.setString("-3");
+    TEST_TRUE(num.value() == "-3" && num.valueInt() == -3);
+}
+
+void testLargeObject() {
+    std::string input = "{";
+    for (int i = 0; i < 100; i++) {
+        input += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+    }
+    input += "\"key7\": 700}";
+    auto json = JSON::fromString(input);
+    auto& obj = json.object();
+    TEST_TRUE(obj.intValueForKey("key99") == 99);
+    TEST_TRUE(obj.intValueForKey("key7") == 700);
+    TEST_TRUE(!obj.contains("key100"));
+
+    // the index follows modifications once it exists
+    obj.addInt("key100", 100);
+    TEST_TRUE(obj.intValueForKey("key100") == 100);
+    TEST_TRUE(obj.remove("key50") && !obj.contains("key50"));
+    TEST_TRUE(obj.intValueForKey("key51") == 51 && obj.intValueForKey("key100") == 100);
+
+    std::unique_ptr<Entity> clone(obj.clone());
+    TEST_TRUE(clone->object().intValueForKey("key7") == 700 && clone->object().count() == obj.count());
+
+    // keys can be views into other text, e.g. into a request line
+    const std::string_view line("GET key42 key43");
+    TEST_TRUE(obj.intValueForKey(line.substr(4, 5)) == 42);
+    TEST_TRUE(json.root()[line.substr(10)].intValue() == 43);
+    TEST_TRUE(obj.setInt(line.substr(4, 5), 4242).valueInt() == 4242 && obj.intValueForKey("key42") == 4242);
+
+    // removals update the index in place, the remaining keys are still found
+    auto members = JSON::fromString("{}");
+    auto& large = members.object();
+    for (int i = 0; i < 300; i++) {
+        large.addInt("m" + std::to_string(i), i);
+    }
+    TEST_TRUE(large.intValueForKey("m299") == 299);
+    // every multiple of 3, in scattered order
+    for (int i = 0; i < 300; i += 3) {
+        large.remove("m" + std::to_string((i * 7) % 300));
+    }
+    bool found = true;
+    for (int i = 0; i < 300; i++) {
+        const bool removed = i % 3 == 0;
+        found = found && (large.contains("m" + std::to_string(i)) != removed) && (removed || large.intValueForKey("m" + std::to_string(i)) == i);
+    }
+    TEST_TRUE(found && large.count() == 200);
+    while (large.count() > 0) {
+        large.remove(std::string(large.begin()->keyView()));
+    }
+    TEST_TRUE(!large.contains("m1") && large.count() == 0);
+
+    // removing the last of equal keys finds the earlier one again
+    TEST_TRUE(obj.remove("key7") && obj.intValueForKey("key7") == 7);
+    TEST_TRUE(obj.remove("key7") && !obj.contains("key7"));
+}
+
+void testInterning() {
+    const std::string input = R"([{"id": 1, "status": "ok"}, {"id": 2, "status": "ok"}, {"id": 3, "status": "failed"}])";
+    const auto json = JSON::fromString(input);
+    const auto& arr = json.array();
+    TEST_TRUE(arr[0].object().begin()->keyView().data() == arr[2].object().begin()->keyView().data());
+    TEST_TRUE(arr[0].object().stringViewForKey("status").data() == arr[1].object().stringViewForKey("status").data());
+    TEST_TRUE(arr[2].object().stringValueForKey("status") == "failed");
+
+    // the pooled key is the copy stored in every object, lookups with it match by pointer
+    const auto key = json.pooledKey("status");
+    for (const auto* element : arr) {
+        TEST_TRUE((++element->object().begin())->keyView().data() == key.data());
+    }
+    TEST_TRUE(arr[1].object().stringViewForKey(key) == "ok");
+    const std::string missing = "missing";
+    TEST_TRUE(json.pooledKey(missing).data() == missing.data());
+
+    Parser parser;
+    parser.setInternStrings(false);
+    const auto copied = parser.parse(input);
+    TEST_TRUE(copied.array()[0].object().begin()->keyView().data() != copied.array()[2].object().begin()->keyView().data());
+
+    DocumentBuilder builder;
+    Parser().parse(input, builder);
+    const auto built = builder.document();
+    TEST_TRUE(built.array()[0].object().begin()->keyView().data() == built.array()[1].object().begin()->keyView().data());
+}
+
+void testTape() {
+    const auto tape = Tape::parse(R"({"name": "tape", "count": 3, "ratio": 0.5, "ok": true, "none": null,
+        "items": [1, {"id": 7}, [], "x"], "name": "last", "empty": {}})");
+    const auto root = tape.root();
+    TEST_TRUE(root.isObject() && root.count() == 8);
+
+    const auto obj = root.object();
+    TEST_TRUE(obj.stringViewForKey("name") == "last");
+    TEST_TRUE(obj.intValueForKey("count") == 3 && obj.doubleValueForKey("ratio") == 0.5);
+    TEST_TRUE(obj.boolValueForKey("ok") && obj["none"].isNull());
+    TEST_TRUE(obj.intValueForKey("missing", -1) == -1 && !obj.contains("missing"));
+    TEST_TRUE(obj.objectForKey("empty")->count() == 0 && !obj.arrayForKey("name"));
+
+    const auto items = obj.arrayForKey("items");
+    TEST_TRUE(items && items->count() == 4);
+    TEST_TRUE((*items)[1]["id"].intValue() == 7 && (*items)[3].stringView() == "x");
+
+    int sum = 0;
+    for (const auto& value : *items) {
+        sum += value.isNumber() ? value.intValue() : 0;
+    }
+    TEST_TRUE(sum == 1);
+
+    std::string keys;
+    for (const auto& member : obj) {
+        keys += std::string(member.key()) + ",";
+    }
+    TEST_TRUE(keys == "name,count,ratio,ok,none,items,name,empty,");
+}
+
+void testTapeSnapshot() {
+    // large objects get key tables, the duplicate key keeps its last value
+    std::string input = R"({"list": [1, 2.5, "three"], )";
+    for (int i = 0; i < 100; i++) {
+        input += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+    }
+    input += R"("key5": "last"})";
+
+    const char* path = "cson_test_snapshot.tape";
+    Tape::parse(input).save(path);
+    const auto tape = Tape::map(path);
+    const auto obj = tape.root().object();
+    TEST_TRUE(obj.count() == 102);
+    TEST_TRUE(obj.intValueForKey("key99") == 99 && obj.intValueForKey("key0") == 0);
+    TEST_TRUE(obj.stringViewForKey("key5") == "last");
+    TEST_TRUE(!obj.contains("key100") && obj.contains("list"));
+    TEST_TRUE(obj["list"][1].doubleValue() == 2.5 && obj["list"][2].stringView() == "three");
+    TEST_TRUE(tape.words() == Tape::parse(input).words());
+    remove(path);
+}
+
+void testTapeSnapshotInvalid() {
+    // JSON text is not a snapshot
+    const char* path = "cson_test_snapshot.json";
+    const auto json = JSON::fromString(R"({"key": "a value that is longer than a snapshot header, to get past the size check"})");
+    json.save(json.root(), path);
+    try {
+        Tape::map(path);
+    } catch (...) {
+        remove(path);
+        throw;
+    }
+    remove(path);
+}
+
+static size_t visitTape(const TapeValue& value) {
+    size_t visited = 1;
+    if (value.isObject()) {
+        const auto obj = value.object();
+        visited += obj.count();
+        for (const auto& member : obj) {
+            visited += visitTape(member.value()) + obj.contains(member.key());
+        }
+    } else if (value.isArray()) {
+        visited += value.count();
+        for (const auto& element : value.array()) {
+            visited += visitTape(element);
+        }
+    } else if (value.isString()) {
+        visited += value.stringView().size();
+    } else if (value.isNumber()) {
+        visited += value.doubleValue() > 0;
+    }
+    return visited;
+}
+
+void testTapeSnapshotCorrupt() {
+    // large enough for a key table
+    std::string input = R"({"list": [1, 2.5, "three", {"x": [true, null]}], )";
+    for (int i = 0; i < 20; i++) {
+        input += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+    }
+    input += R"("last": "value"})";
+    std::string snapshot;
+    StringSink sink(snapshot);
+    Tape::parse(input).write(sink);
+
+    // flipped bits in container ends, counts, string offsets and tags are rejected when
+    // mapping, everything that maps can be read within the snapshot
+    const char* path = "cson_test_corrupt.tape";
+    const size_t headerSize = 64;
+    const size_t wordCount = Tape::parse(input).words();
+    size_t rejected = 0;
+    for (size_t word = 0; word < wordCount; word++) {
+        for (const int bit : {2, 30, 40, 57}) {
+            std::string corrupt = snapshot;
+            corrupt[headerSize + word * 8 + bit / 8] ^= static_cast<char>(1 << (bit % 8));
+            FILE* f = fopen(path, "wb");
+            fwrite(corrupt.data(), 1, corrupt.size(), f);
+            fclose(f);
+            try {
+                visitTape(Tape::map(path).root());
+            } catch (const IOError&) {
+                rejected++;
+            } catch (const Exception&) {
+            }
+        }
+    }
+    remove(path);
+    TEST_TRUE(rejected > wordCount);
+
+    // a snapshot cut after its header
+    FILE* f = fopen(path, "wb");
+    fwrite(snapshot.data(), 1, headerSize + 8, f);
+    fclose(f);
+    bool truncated = false;
+    try {
+        Tape::map(path);
+    } catch (const IOError&) {
+        truncated = true;
+    }
+    remove(path);
+    TEST_TRUE(truncated);
+}
+
+void testTapeTypeMismatch() {
+    Tape::parse("[1]").root()[0].stringView();
+}
+
+void testLazy() {
+    const std::string input = R"({"a": {"b": [1, 2, {"c": "d\"e"}]}, "skipped": {"x": [1, [2, "]"]], // ] }
+        "y": "}"}, "n": 5})";
+    const auto json = JSON::lazy(input, { JSON::Option::enableComments });
+    const auto& obj = json.object();
+    TEST_TRUE(obj.count() == 3);
+    TEST_TRUE(obj.intValueForKey("n") == 5);
+    TEST_TRUE(obj["a"]["b"].count() == 3);
+    TEST_TRUE(obj["a"]["b"][2].object().stringValueForKey("c") == "d\"e");
+    TEST_TRUE(obj["skipped"]["y"].stringView() == "}");
+    const auto eager = JSON::fromString(input, { JSON::Option::enableComments });
+    TEST_TRUE(json.toString(json.root()) == eager.toString(eager.root()));
+
+    // containers are found through the index recorded while validating, in any order
+    const auto nested = JSON::lazy(std::string(R"([[], [[], [{}]], {"k": [[3]]}, [4]])"));
+    TEST_TRUE(nested.array()[3][0].number().valueInt64() == 4);
+    TEST_TRUE(nested.array()[2]["k"][0][0].number().valueInt64() == 3);
+    TEST_TRUE(nested.array()[1][1][0].count() == 0 && nested.array()[0].count() == 0);
+    TEST_TRUE(nested.toString(nested.root()) == "[[],[[],[{}]],{\"k\":[[3]]},[4]]");
+
+    // modifications parse the container first
+    auto lazy = JSON::lazy(std::string(R"({"list": [1, 2]})"));
+    lazy.object()["list"].array().addInt(3);
+    TEST_TRUE(lazy.toString(lazy.root()) == R"({"list":[1,2,3]})");
+}
+
+static std::string largeArray(size_t count) {
+    std::string input = "[";
+    for (size_t i = 0; i < count; i++) {
+        input += (i ? ",\n" : "") + std::string(R"({"id": )") + std::to_string(i) + R"(, "name": "record \"quoted\"", "values": [1.5, true, null, {"nested": []}]})";
+    }
+    return input + "]";
+}
+
+void testParallel() {
+    const std::string input = largeArray(20000);
+    TEST_TRUE(input.size() > Parser::s_MinParallelLength);
+
+    Parser parser;
+    parser.setThreads(4);
+    const auto json = parser.parse(input);
+    const auto& arr = json.array();
+    TEST_TRUE(arr.count() == 20000);
+    TEST_TRUE(arr.objectAtIndex(12345).intValueForKey("id") == 12345);
+    TEST_TRUE(arr.objectAtIndex(19999).stringValueForKey("name") == "record \"quoted\"");
+    const auto sequential = JSON::fromString(input);
+    TEST_TRUE(json.toString(json.root()) == sequential.toString(sequential.root()));
+
+    parser.setThreads(0);
+    TEST_TRUE(parser.parse("[]").array().count() == 0);
+    TEST_TRUE(parser.parse(R"(["a", 1])").array().count() == 2);
+}
+
+void testParallelError() {
+    std::string input = largeArray(20000);
+    input.replace(input.find("true", input.size() / 2), 4, "ture");
+    Parser parser;
+    parser.setThreads(4);
+    parser.parse(input);
+}
+
+template<class F>
+static bool rejects(F parse) {
+    try {
+        parse();
+    } catch (const ParseError&) {
+        return true;
+    }
+    return false;
+}
+
+void testMalformedKey() {
+    // a key without its opening quote is rejected whichever parser reads it
+    const std::string input = R"({a": 1})";
+    TEST_TRUE(rejects([&] { JSON::fromString(input); }));
+    TEST_TRUE(rejects([&] { JSON::fromString(input, { JSON::Option::enableComments }); }));
+    TEST_TRUE(rejects([&] { JSON::lazy(input); }));
+    TEST_TRUE(rejects([&] { Tape::parse(input); }));
+    TEST_TRUE(rejects([&] { Handler handler; Parser().parse(input, handler); }));
+    TEST_TRUE(rejects([&] { Parser parser; parser.setProjection({"a"}); parser.parse(input); }));
+    TEST_TRUE(rejects([&] { Parser parser; parser.setProjection({"b"}); parser.parse(input); }));
+
+    std::string large = largeArray(20000);
+    large.replace(large.find(R"("name")", large.size() / 2), 6, R"(name")");
+    TEST_TRUE(rejects([&] { Parser parser; parser.setThreads(4); parser.parse(large); }));
+}
+
+void testNDJSON() {
+    // several batches, with an empty line and a bad line
+    std::string input;
+    for (size_t i = 1; i <= 20000; i++) {
+        input += i == 7 ? "\n" : (i == 9000 ? "{\"id\": }\n" : R"({"id": )" + std::to_string(i) + ", \"text\": \"" + std::string(20, 'x') + "\"}\r\n");
+    }
+    TEST_TRUE(input.size() > 2 * NDJSONReader::s_BatchLength);
+
+    NDJSONReader reader;
+    reader.setThreads(3);
+    std::vector<size_t> badLines;
+    reader.setSkipBadLines(true, [&badLines](size_t line, const ParseError&) { badLines.push_back(line); return true; });
+    size_t expected = 1;
+    bool ordered = true;
+    const size_t count = reader.read(input, [&](size_t line, JSON& json) {
+        expected += (expected == 7 || expected == 9000) ? 1 : 0;
+        ordered = ordered && line == expected && json.object().intValueForKey("id") == static_cast<int>(line);
+        expected++;
+        return true;
+    });
+    TEST_TRUE(count == 19998);
+    TEST_TRUE(ordered);
+    TEST_TRUE(badLines.size() == 1 && badLines[0] == 9000);
+
+    reader.setOrdered(false);
+    size_t sum = 0;
+    reader.read(input, [&sum](size_t line, JSON&) { sum += line; return true; });
+    TEST_TRUE(sum == 20000 * 20001 / 2 - 7 - 9000);
+
+    // stops after the first document
+    TEST_TRUE(reader.read(input, [](size_t, JSON&) { return false; }) == 1);
+}
+
+void testNDJSONError() {
+    NDJSONReader reader;
+    reader.read("{\"a\": 1}\n[1, 2\n{}", [](size_t, JSON&) { return true; });
+}
+
+void testPipeline() {
+    std::string input;
+    for (size_t i = 1; i <= 20000; i++) {
+        input += i == 500 ? "[1, 2\n" : "{\"id\": " + std::to_string(i) + ", \"text\": \"" + std::string(20, 'x') + "\"}\n";
+    }
+
+    NDJSONPipeline pipeline;
+    pipeline.setThreads(3);
+    pipeline.setQueueLength(2);
+    size_t badLine = 0;
+    pipeline.setSkipBadLines(true, [&badLine](size_t line, const ParseError&) { badLine = line; return true; });
+    std::string output;
+    StringSink sink(output);
+    const size_t count = pipeline.run(input, sink, [](JSON& json) {
+        // odd ids are dropped, even ids get a field
+        const int id = json.object().intValueForKey("id");
+        json.object().addBoolean("even", true);
+        return id % 2 == 0;
+    });
+    TEST_TRUE(count == 9999);
+    TEST_TRUE(badLine == 500);
+
+    size_t expected = 2;
+    bool ordered = true;
+    NDJSONReader reader;
+    reader.read(output, [&](size_t, JSON& json) {
+        ordered = ordered && json.object().intValueForKey("id") == static_cast<int>(expected) && json.object().boolValueForKey("even");
+        expected += expected == 498 ? 4 : 2;
+        return true;
+    });
+    TEST_TRUE(ordered && expected == 20002);
+}
+
+void testBinary() {
+    const auto json = JSON::fromString(R"({"a": 1, "b": [2, 3]})");
+    TEST_TRUE(CBOR::encode(json.root()) == std::string("\xa2\x61\x61\x01\x61\x62\x82\x02\x03"));
+    TEST_TRUE(MessagePack::encode(json.root()) == std::string("\x82\xa1\x61\x01\xa1\x62\x92\x02\x03"));
+
+    const std::string text = R"({"int": -1234567, "big": 9007199254740993, "neg": -40, "float": 1.5, "double": 0.1,
+        "text": "long enough to not be interned by the decoder at all", "list": [true, false, null, {}, []],
+        "nested": {"key": "value"}, "unicode": "\u00e4"})";
+    const auto document = JSON::fromString(text);
+    const std::string expected = document.toString(document.root());
+    const auto fromCBOR = CBOR::decode(CBOR::encode(document.root()));
+    TEST_TRUE(fromCBOR.toString(fromCBOR.root()) == expected);
+    const auto fromMessagePack = MessagePack::decode(MessagePack::encode(document.root()));
+    TEST_TRUE(fromMessagePack.toString(fromMessagePack.root()) == expected);
+
+    // half floats, indefinite lengths and tags
+    const auto cbor = CBOR::decode(std::string("\x9f\xf9\x3c\x00\x7f\x61\x61\x62\x62\x63\xff\xc1\x1a\x00\x01\x00\x00\x3b\xff\xff\xff\xff\xff\xff\xff\xff\xff", 27));
+    TEST_TRUE(cbor.array().count() == 4);
+    TEST_TRUE(cbor.array().doubleValueAtIndex(0) == 1.0);
+    TEST_TRUE(cbor.array().stringValueAtIndex(1) == "abc");
+    TEST_TRUE(cbor.array().numberAtIndex(2).valueInt64() == 65536);
+    TEST_TRUE(cbor.array().doubleValueAtIndex(3) == -18446744073709551616.0);
+
+    // long chains of tags do not nest
+    std::string tagged(100000, '\xc1');
+    tagged += '\x01';
+    TEST_TRUE(CBOR::decode(tagged).root().number().valueInt64() == 1);
+}
+
+struct Address {
+    std::string city;
+    int zip = 0;
+};
+CSON_BIND(Address, CSON_FIELD(city), CSON_FIELD(zip))
+
+struct Person {
+    std::string name;
+    int64_t id = 0;
+    double score = 0.0;
+    bool active = false;
+    std::optional<std::string> nickname;
+    std::vector<int> values;
+    std::vector<Address> addresses;
+    std::map<std::string, double> ratings;
+};
+CSON_BIND(Person, CSON_FIELD(name), cson::field("ID", &CsonBound::id), CSON_FIELD(score), CSON_FIELD(active),
+    CSON_FIELD(nickname), CSON_FIELD(values), CSON_FIELD(addresses), CSON_FIELD(ratings))
+
+void testBinding() {
+    const auto person = fromJSON<Person>(R"({"ratings": {"a": 1.5, "b": -2}, "name": "Jäne", "ID": 12345678901,
+        "unknown": [{"x": [1, {}]}, "y"], "score": 4.25, "active": true, "nickname": null,
+        "values": [1, 2, 3], "addresses": [{"city": "Berlin", "zip": 10115}, {"zip": 1}]})");
+    TEST_TRUE(person.name == "J\xc3\xa4ne");
+    TEST_TRUE(person.id == 12345678901);
+    TEST_TRUE(person.score == 4.25);
+    TEST_TRUE(person.active);
+    TEST_TRUE(!person.nickname);
+    TEST_TRUE(person.values == std::vector<int>({1, 2, 3}));
+    TEST_TRUE(person.addresses.size() == 2);
+    TEST_TRUE(person.addresses[0].city == "Berlin" && person.addresses[0].zip == 10115);
+    TEST_TRUE(person.addresses[1].city.empty() && person.addresses[1].zip == 1);
+    TEST_TRUE(person.ratings.size() == 2 && person.ratings.at("b") == -2.0);
+
+    // empty optionals are left out, the text parses to the same tree
+    const std::string text = toJSON(person);
+    TEST_TRUE(text == R"({"name":"J)" "\xc3\xa4" R"(ne","ID":12345678901,"score":4.25,"active":true,"values":[1,2,3],)"
+        R"("addresses":[{"city":"Berlin","zip":10115},{"city":"","zip":1}],"ratings":{"a":1.5,"b":-2}})");
+    const auto copy = fromJSON<Person>(text);
+    TEST_TRUE(copy.addresses[0].city == "Berlin" && copy.ratings.at("a") == 1.5);
+
+    DocumentBuilder builder;
+    Binding<Person>::write(builder, person);
+    const auto json = builder.document();
+    TEST_TRUE(json.object().numberForKey("ID")->valueInt64() == 12345678901);
+
+    // out of range values are clamped
+    const auto values = fromJSON<std::vector<int>>("[1e+30, -5000000000, 2.9]");
+    TEST_TRUE(values == std::vector<int>({INT_MAX, INT_MIN, 2}));
+
+    // unsigned values above 2^63 round trip
+    const auto ids = fromJSON<std::vector<uint64_t>>("[18446744073709551615, 9223372036854775808, -1, 1e+30]");
+    TEST_TRUE(ids == std::vector<uint64_t>({UINT64_MAX, 9223372036854775808ull, 0, UINT64_MAX}));
+    TEST_TRUE(toJSON(ids) == "[18446744073709551615,9223372036854775808,0,18446744073709551615]");
+    TEST_TRUE(fromJSON<std::vector<uint8_t>>("[300, 7]") == std::vector<uint8_t>({255, 7}));
+}
+
+void testPointer() {
+    auto json = JSON::fromString(R"({"a": {"b": [1, {"c": "x"}]}, "": 0, "m~n": 1, "k/l": 2, "07": 3})");
+    TEST_TRUE(JSONPointer("").find(json.root()) == &json.root());
+    TEST_TRUE(JSONPointer("/a/b/1/c").find(json.root())->stringValue() == "x");
+    TEST_TRUE(JSONPointer("/").find(json.root())->intValue() == 0);
+    TEST_TRUE(JSONPointer("/m~0n").find(json.root())->intValue() == 1);
+    TEST_TRUE(JSONPointer("/k~1l").find(json.root())->intValue() == 2);
+    TEST_TRUE(JSONPointer("/07").find(json.root())->intValue() == 3);
+    TEST_TRUE(JSONPointer("/a/b/2").find(json.root()) == nullptr);
+    TEST_TRUE(JSONPointer("/a/b/-").find(json.root()) == nullptr);
+    TEST_TRUE(JSONPointer("/a/b/01").find(json.root()) == nullptr);
+    TEST_TRUE(JSONPointer("/a/b/0/c").find(json.root()) == nullptr);
+    TEST_TRUE(JSONPointer("/a/x").find(json.root()) == nullptr);
+
+    // one pointer for many documents, large objects are looked up in their hash index
+    const JSONPointer pointer("/values/key40");
+    for (int i = 0; i < 3; i++) {
+        auto& values = json.object().addObject("values");
+        for (int k = 0; k < 64; k++) {
+            values.addInt("key" + std::to_string(k), k + i);
+        }
+        TEST_TRUE(pointer.find(json.root())->intValue() == 40 + i);
+        json.object().remove("values");
+    }
+}
+
+static std::string selectPath(const char* path, const std::string& text) {
+    std::string result;
+    for (const auto& match : JSONPath(path).select(text)) {
+        result += (result.empty() ? "" : " ") + match.toString(match.root());
+    }
+    return result;
+}
+
+void testPath() {
+    const std::string text = R"({"store": {"book": [
+        {"title": "a", "price": 8.95, "tags": ["x"]},
+        {"title": "b", "price": 12.99, "isbn": "0-553"},
+        {"title": "c", "price": 8.99, "meta": {"price": 1}},
+        {"title": "d", "price": 22.99}
+    ], "bicycle": {"color": "red", "price": 19.95}}, "count": 4})";
+
+    TEST_TRUE(selectPath("$.store.book[*].title", text) == R"("a" "b" "c" "d")");
+    TEST_TRUE(selectPath("$['store']['bicycle'].color", text) == R"("red")");
+    TEST_TRUE(selectPath("$..price", text) == "8.95 12.99 8.99 1 22.99 19.95");
+    TEST_TRUE(selectPath("$.store.book[1].title", text) == R"("b")");
+    TEST_TRUE(selectPath("$.store.book[-1].title", text) == R"("d")");
+    TEST_TRUE(selectPath("$.store.book[1:3].title", text) == R"("b" "c")");
+    TEST_TRUE(selectPath("$.store.book[::2].title", text) == R"("a" "c")");
+    TEST_TRUE(selectPath("$.store.book[-2:].title", text) == R"("c" "d")");
+    TEST_TRUE(selectPath("$.store.book[?(@.price < 10)].title", text) == R"("a" "c")");
+    TEST_TRUE(selectPath("$.store.book[?(@.isbn)].title", text) == R"("b")");
+    TEST_TRUE(selectPath("$.store.book[?(@.meta.price == 1)].title", text) == R"("c")");
+    TEST_TRUE(selectPath("$.store.book[?(@.title != 'a')].price", text) == "12.99 8.99 22.99");
+    TEST_TRUE(selectPath("$..book[0].tags[0]", text) == R"("x")");
+    TEST_TRUE(selectPath("$.count", text) == "4");
+    TEST_TRUE(selectPath("$.missing", text).empty());
+    TEST_TRUE(selectPath("$", R"({"a":1})") == R"({"a":1})");
+
+    // matches inside matches
+    TEST_TRUE(selectPath("$..a", R"({"a": {"a": 1}})") == R"({"a":1} 1)");
+
+    size_t count = 0;
+    const bool completed = JSONPath("$..title").evaluate(text, [&count](JSON&) {
+        return ++count < 2;
+    });
+    TEST_TRUE(!completed && count == 2);
+}
+
+void testProjection() {
+    const std::string text = R"([
+        {"id": 1, "user": {"name": "a", "email": "x", "tags": ["t"]}, "payload": {"big": [1, 2, {"\"}": "]"}]}, "items": [{"price": 1, "sku": "s"}, 2]},
+        {"user": "none", "id": 2, "items": []}
+    ])";
+
+    Parser parser;
+    parser.setProjection({"id", "user.name", "items.price", "user.tags", "user.tags.x"});
+    const auto json = parser.parse(text);
+    const auto& first = json.array()[0].object();
+    TEST_TRUE(first.count() == 3);
+    TEST_TRUE(first.intValueForKey("id") == 1);
+    TEST_TRUE(first.objectForKey("user")->count() == 2);
+    TEST_TRUE(first.objectForKey("user")->stringValueForKey("name") == "a");
+    TEST_TRUE(first.objectForKey("user")->arrayForKey("tags")->count() == 1);
+    TEST_TRUE(!first.contains("payload"));
+    const auto& items = *first.arrayForKey("items");
+    TEST_TRUE(items.count() == 2 && items[0].object().count() == 1 && items[0].object().intValueForKey("price") == 1);
+
+    // a value without the projected keys is dropped
+    const auto& second = json.array()[1].object();
+    TEST_TRUE(second.count() == 2 && !second.contains("user"));
+
+    parser.setProjection({});
+    TEST_TRUE(parser.parse(text).array()[0].object().contains("payload"));
+
+    // skipped members are followed by the same punctuation as kept ones
+    parser.setProjection({"id"});
+    TEST_TRUE(parser.parse(R"({"x": 1, "id": 2})").object().count() == 1);
+    bool rejected = false;
+    try {
+        parser.parse(R"({"x": 1,})");
+    } catch (const ParseError&) {
+        rejected = true;
+    }
+    TEST_TRUE(rejected);
+
+    // elements of a parallel parsed array are projected as well
+    const std::string large = largeArray(20000);
+    parser.setThreads(4);
+    parser.setProjection({"id"});
+    const auto parallel = parser.parse(large);
+    TEST_TRUE(parallel.array().count() == 20000);
+    TEST_TRUE(parallel.array()[19999].object().count() == 1);
+}
+
+void testOwnership() {
+    auto target = JSON::fromString(R"({"list": [1]})");
+    const Entity* moved = nullptr;
+    {
+        auto source = JSON::fromString(R"({"items": [{"id": 1}, {"id": 2}], "name": "source"})");
+        auto items = source.object().take("items");
+        TEST_TRUE(!source.object().contains("items") && items.array().count() == 2);
+        moved = &items.root();
+        TEST_TRUE(&target.object().add("items", std::move(items)) == moved);
+
+        auto element = target.object().arrayForKey("items")->takeAtIndex(0);
+        TEST_TRUE(target.object().arrayForKey("items")->count() == 1);
+        const Entity* elementRoot = &element.root();
+        TEST_TRUE(&target.object().arrayForKey("list")->add(std::move(element)) == elementRoot);
+    }
+    // the source arena lives as long as the target needs it
+    TEST_TRUE(&target.object()["items"] == moved);
+    TEST_TRUE(target.object()["items"][0].object().intValueForKey("id") == 2);
+    TEST_TRUE(target.object()["list"][1].object().intValueForKey("id") == 1);
+
+    // heap entities are owned by the arena of their container until they are removed or taken
+    std::unique_ptr<Entity> heap(new Object());
+    heap->object().addInt("a", 1);
+    const Entity* heapObject = heap.get();
+    TEST_TRUE(&target.object().add("heap", std::move(heap)) == heapObject);
+    auto taken = target.object().take("heap");
+    TEST_TRUE(&taken.root() == heapObject && taken.object().intValueForKey("a") == 1);
+    target.object().add("heap", std::move(taken));
+    TEST_TRUE(target.object().remove("heap"));
+
+    // heap containers copy subtrees of arena documents
+    std::unique_ptr<Entity> container(new Array());
+    container->array().add(target.object().take("list"));
+    TEST_TRUE(container->array()[0][1].object().intValueForKey("id") == 1);
+
+    // arenas never retain each other, moving back copies
+    auto back = JSON::fromString(R"({"x": {"y": 1}})");
+    auto x = back.object().take("x");
+    const Entity* xRoot = &x.root();
+    target.object().add("x", std::move(x));
+    back.object().add("items", target.object().take("items"));
+    TEST_TRUE(back.object()["items"][0].object().intValueForKey("id") == 2);
+    auto xBack = target.object().take("x");
+    TEST_TRUE(&back.object().add("x", std::move(xBack)) == xRoot);
+
+    // strings are moved instead of copied
+    std::string text(100, 'x');
+    const char* data = text.data();
+    TEST_TRUE(target.object().addString("text", std::move(text)).view().data() == data);
+    TEST_TRUE(target.object().stringValueForKey("text") == std::string(100, 'x'));
+
+    // elements of a parallel parsed array live in the arenas of the workers
+    std::optional<JSON> element;
+    {
+        Parser parser;
+        parser.setThreads(4);
+        auto json = parser.parse(largeArray(20000));
+        element.emplace(json.array().takeAtIndex(19999));
+    }
+    TEST_TRUE(element->object().intValueForKey("id") == 19999);
+}
+
+void testLoad() {
+    const char* path = "cson_test_load.json";
+    FILE* f = fopen(path, "wb");
+    fputs(JSON_TYPES, f);
+    fclose(f);
+
+    const auto json = JSON::load(path);
+    TEST_TRUE(json.object()["string1"].stringValue() == "Hello");
+    TEST_TRUE(json.object()["array"].array().count() == 3);
+
+    const auto zeroCopyJson = JSON::load(path, { JSON::Option::zeroCopy });
+    TEST_TRUE(zeroCopyJson.object().stringViewForKey("string1") == "Hello");
+    TEST_TRUE(zeroCopyJson.object()["num5"].doubleValue() == 110);
+    remove(path);
+}
+
+class PriceSum : public Handler {
+public:
+    bool key(std::string_view key) override {
+        mIsPrice = key == "price";
+        return true;
+    }
+
+    bool number(std::string_view number) override {
+        if (mIsPrice) {
+            mSum += atof(std::string(number).c_str());
+        }
+        return true;
+    }
+
+    bool string(std::string_view value) override {
+        mStrings += std::string(value);
+        return mStrings.size() < mMaxStringBytes;
+    }
+
+    double mSum = 0;
+    std::string mStrings;
+    size_t mMaxStringBytes = 1000;
+private:
+    bool mIsPrice = false;
+};
+
+void testEvents() {
+    const std::string input = R"({"items": [{"name": "a\"b", "price": 1.5}, {"name": "c", "price": 2}], "price": 10})";
+
+    Parser parser;
+    PriceSum sum;
+    TEST_TRUE(parser.parse(input, sum));
+    TEST_TRUE(sum.mSum == 13.5);
+    TEST_TRUE(sum.mStrings == "a\"bc");
+
+    PriceSum stopped;
+    stopped.mMaxStringBytes = 1;
+    TEST_TRUE(!parser.parse(input, stopped));
+    TEST_TRUE(stopped.mSum == 0);
+
+    Handler ignore;
+    TEST_TRUE(parser.parse(JSON_TYPES, ignore));
+}
+
+void testPushParser() {
+    const std::string input = std::string(JSON_TYPES) + R"(
+    )";
+    const std::string expected = JSON::fromString(input).object().toString(false);
+
+    for (size_t chunkSize = 1; chunkSize < 20; chunkSize++) {
+        DocumentBuilder builder;
+        PushParser parser(builder);
+        for (size_t pos = 0; pos < input.size(); pos += chunkSize) {
+            parser.feed(input.data() + pos, std::min(chunkSize, input.size() - pos));
+        }
+        if (!parser.isComplete()) {
+            FAIL("TEST_TRUE", parser.isComplete());
+        }
+        parser.finish();
+        const auto json = builder.document();
+        if (json.object().toString(false) != expected) {
+            FAIL("TEST_TRUE", json.object().toString(false) == expected);
+        }
+    }
+    SUCCESS("TEST_TRUE", all chunk sizes);
+
+    const std::string withComments = "[ // first\n 1, \"a\\u00e4\" // second\n ]";
+    DocumentBuilder builder;
+    PushParser parser(builder);
+    parser.allowComments(true);
+    for (char c : withComments) {
+        parser.feed(&c, 1);
+    }
+    parser.finish();
+    const auto json = builder.document();
+    TEST_TRUE(json.array().count() == 4);
+    TEST_TRUE(json.array()[2].stringValue() == "a\xc3\xa4");
+
+    PriceSum sum;
+    PushParser eventParser(sum);
+    eventParser.feed(R"({"price": 1)");
+    eventParser.feed(R"(2.5, "other": 3})");
+    eventParser.finish();
+    TEST_TRUE(sum.mSum == 12.5);
+}
+
+void testIncomplete(const std::string& jsonString) {
+    DocumentBuilder builder;
+    PushParser parser(builder);
+    parser.feed(jsonString);
+    parser.finish();
+}
+
+void testSerializer() {
+    const auto json = JSON::fromString(JSON_TYPES);
+    const std::string expected = json.object().toString(false);
+
+    std::string str;
+    StringSink stringSink(str);
+    Serializer(stringSink, false).write(json.root());
+    TEST_TRUE(str == expected);
+
+    char buf[4096];
+    BufferSink bufferSink(buf, sizeof(buf));
+    Writer(false).write(bufferSink, json.root());
+    TEST_TRUE(std::string(buf, bufferSink.size()) == expected);
+
+    FILE* f = tmpfile();
+    FileSink fileSink(f);
+    Serializer(fileSink, true, "\t").write(json.root());
+    rewind(f);
+    const size_t rd = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    TEST_TRUE(std::string(buf, rd) == json.toString(json.root(), { JSON::Option::prettyPrint, JSON::Option::indentTab }));
+
+    // output beyond the inline buffer, written into a string and through a sink
+    const auto large = JSON::fromString(largeArray(2000));
+    std::string direct;
+    Serializer(direct, false).write(large.root());
+    std::string sunk;
+    StringSink largeSink(sunk);
+    Serializer(largeSink, false).write(large.root());
+    TEST_TRUE(direct == sunk && direct.size() > 64 * 1024);
+    TEST_TRUE(JSON::fromString(direct).array().count() == 2000);
+}
+
+void testBufferTooSmall() {
+    char buf[8];
+    BufferSink sink(buf, sizeof(buf));
+    Serializer(sink).write(JSON::fromString(JSON_TYPES).root());
+}
+
+void testArena() {
+    std::string jsonString = "{\"items\": [";
+    for (int i = 0; i < 10000; i++) {
+        if (i > 0) {
+            jsonString += ",";
+        }
+        jsonString += "{\"id\": " + std::to_string(i) + ", \"name\": \"item number " + std::to_string(i) + "\"}";
+    }
+    jsonString += "]}";
+
+    auto json = JSON::fromString(jsonString);
+    auto& items = json.object()["items"].array();
+    TEST_TRUE(items.count() == 10000);
+    TEST_TRUE(items[9999]["id"].intValue() == 9999);
+    TEST_TRUE(items[1234]["name"].stringValue() == "item number 1234");
+    TEST_TRUE(items[1234].keyByIndex(1) == "name");
+
+    // parsed documents can still be modified
+    auto& first = items.objectAtIndex(0);
+    first.addString("added", "a value that is too long for any small string optimization");
+    first.setString("name", "renamed");
+    TEST_TRUE(first.remove("id"));
+    TEST_TRUE(!first.contains("id"));
+    first.addArray("list").addInt(42);
+    TEST_TRUE(first.stringValueForKey("added") == "a value that is too long for any small string optimization");
+    TEST_TRUE(first.stringValueForKey("name") == "renamed");
+    TEST_TRUE(first["list"][0].intValue() == 42);
+    items.removeAtIndex(1);
+    TEST_TRUE(items.count() == 9999);
+
+    std::unique_ptr<Entity> copy(first.clone());
+    TEST_TRUE(copy->arena() == nullptr);
+    TEST_TRUE(copy->toString(false) == first.toString(false));
+
+    const auto reparsed = JSON::fromString(json.object().toString(false));
+    TEST_TRUE(reparsed.object().toString(false) == json.object().toString(false));
+}
+
 void testDepth(const std::string& jsonString, size_t maxDepth) {
     Parser parser;
     parser.setMaxDepth(maxDepth);
@@ -161,11 +1120,70 @@ void testDepth(const std::string& jsonString, size_t maxDepth) {
 int main() {
     RUN_TEST(testTypes());
     RUN_TEST(testIterators());
+    RUN_TEST(testStrings());
+    RUN_TEST(testWhitespace());
+    RUN_TEST(testStructuralIndex());
+    RUN_TEST(testZeroCopy());
+    RUN_TEST(testNumbers());
+    RUN_TEST(testLargeObject());
+    RUN_TEST(testInterning());
+    RUN_TEST(testTape());
+    RUN_TEST(testTapeSnapshot());
+    RUN_TEST(testTapeSnapshotCorrupt());
+    RUN_TEST(testLazy());
+    RUN_TEST(testParallel());
+    RUN_TEST(testMalformedKey());
+    RUN_TEST(testNDJSON());
+    RUN_TEST(testPipeline());
+    RUN_TEST(testBinary());
+    RUN_TEST(testBinding());
+    RUN_TEST(testPointer());
+    RUN_TEST(testPath());
+    RUN_TEST(testProjection());
+    RUN_TEST(testOwnership());
+    RUN_TEST(testLoad());
+    RUN_TEST(testEvents());
+    RUN_TEST(testPushParser());
+    RUN_TEST(testSerializer());
+    RUN_TEST(testArena());
     RUN_TEST(testDepth(JSON_ARRAY_DEPTH, 10));
     RUN_TEST(testDepth(JSON_OBJECT_DEPTH, 10));
     RUN_TEST(testDepth(JSON_MIXED_DEPTH, 10));
     RUN_TEST_EXCEPT(testDepth(JSON_ARRAY_DEPTH, 9), TooManyNestings);
     RUN_TEST_EXCEPT(testDepth(JSON_OBJECT_DEPTH, 9), TooManyNestings);
     RUN_TEST_EXCEPT(testDepth(JSON_MIXED_DEPTH, 9), TooManyNestings);
+    RUN_TEST_EXCEPT(JSON::load("does_not_exist.json"), IOError);
+    RUN_TEST_EXCEPT(testTapeSnapshotInvalid(), IOError);
+    RUN_TEST_EXCEPT(testBufferTooSmall(), OutOfBounds);
+    RUN_TEST_EXCEPT(testTapeTypeMismatch(), InvalidType);
+    RUN_TEST_EXCEPT(Tape::parse(R"({"a": 1)"), ParseError);
+    RUN_TEST_EXCEPT(testIncomplete(R"({"a": "b)"), ParseError);
+    RUN_TEST_EXCEPT(testIncomplete(R"({"a": 1 "b": 2})"), ParseError);
+    RUN_TEST_EXCEPT(testIncomplete(R"([1] x)"), ParseError);
+    RUN_TEST_EXCEPT(Handler handler; Parser().parse("[1, 2", handler), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"(["unterminated)"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"([tru])"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"([truex])"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"([1x])"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"([1 2])"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"([1,])"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"({"a" 1})"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"({"a": 1,})"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(std::string("[1]\0[2]", 7), { JSON::Option::zeroCopy }), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(std::string("[1]\0[2]", 7)), ParseError);
+    RUN_TEST_EXCEPT(testParallelError(), ParseError);
+    RUN_TEST_EXCEPT(testNDJSONError(), ParseError);
+    RUN_TEST_EXCEPT(CBOR::decode(std::string("\x82\x01", 2)), ParseError);
+    RUN_TEST_EXCEPT(MessagePack::decode(std::string("\x81\x01\x02", 3)), ParseError);
+    RUN_TEST_EXCEPT(CBOR::decode(std::string("\x9b\xff\xff\xff\xff\xff\xff\xff\xff\x01\xff", 11)), ParseError);
+    RUN_TEST_EXCEPT(fromJSON<Person>(R"({"name": 1})"), ParseError);
+    RUN_TEST_EXCEPT(fromJSON<Address>(R"({"city": "a",})"), ParseError);
+    RUN_TEST_EXCEPT(JSONPointer("a/b"), ParseError);
+    RUN_TEST_EXCEPT(JSONPointer("/a~2"), ParseError);
+    RUN_TEST_EXCEPT(JSONPath("store.book"), ParseError);
+    RUN_TEST_EXCEPT(JSONPath("$.a[::-1]"), ParseError);
+    RUN_TEST_EXCEPT(JSONPath("$.a").select(R"({"a": 1, "b": [})"), ParseError);
+    RUN_TEST_EXCEPT(JSON::lazy(R"({"a": [1, 2}})"), ParseError);
+    RUN_TEST_EXCEPT(JSON::fromString(R"(["\u12G4"])"), ParseError);
     return 0;
 }